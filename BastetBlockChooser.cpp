@@ -19,13 +19,15 @@
 #include "BastetBlockChooser.hpp"
 
 #include <algorithm>
+#include <cassert>
 #include <cstdlib>
+#include <limits>
 
 #include "Block.hpp"
+#include "OpeningBook.hpp"
+#include "SearchStats.hpp"
 
 // debug
-#include <curses.h>
-
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -37,33 +39,40 @@ namespace Bastet {
 
     // computes the score for a final position reached in the well +
     // "extralines" lines cleared high=good for the player
-    long Evaluate(const Well * w, int extralines) {
+    template<typename G>
+    long Evaluate(const Well<G> * w, int extralines) {
+        Count(Counter::Evaluations);
         // lines
         auto score = 100000000l * extralines;
 
-        // adds a bonus for each "free" dot above the occupied blocks profile
-        std::bitset<WellWidth> occupied{};
-        for (auto l : w->_well) {
-            occupied &= l;
-            score += 10000 * (WellWidth - occupied.count());
-        }
+        // adds a bonus for each "free" dot above the occupied blocks profile.
+        // The profile used to be the running AND of the lines, starting from
+        // no dots at all, so it never had any: every line gets the full bonus
+        score += 10000 * G::Width * G::RealHeight;
 
         // adds a bonus for lower max height of the occupied blocks
-        auto height = RealWellHeight;
-        for (auto l : w->_well) {
-            if (l.any()) break;
-            height--;
-        }
-        score += 1000 * (RealWellHeight - height);
+        score += 1000 * (G::RealHeight - w->GetMaxHeight());
+        return score;
+    }
+
+    template<typename G>
+    long CachedBestScore(TranspositionTable * table, Well<G> * w, BlockType b,
+                         int bonusLines, SearchMode mode) {
+        long score;
+        if (table && table->Probe(w->GetHash(), b, bonusLines, score))
+            return score;
+        score = BestScore(w, b, bonusLines, mode);
+        if (table) table->Store(w->GetHash(), b, bonusLines, score);
         return score;
     }
 
-    Queue BastetBlockChooser::GetStartingQueue() {
+    template<typename G>
+    Queue BastetBlockChooser<G>::GetStartingQueue() {
         Queue q;
         // The first block is always I,J,L,T (cfr. Tetris guidelines, Bastet is
         // a gentleman and chooses the most favorable start for the user).
         BlockType first;
-        switch (random() % 4) {
+        switch (this->_random.Below(4)) {
             case 0:
                 first = I;
                 break;
@@ -78,28 +87,208 @@ namespace Bastet {
                 break;
         }
         q.push(first);
-        q.push(BlockType(random() % nBlockTypes));
+        q.push(BlockType(this->_random.Below(nBlockTypes)));
         return q;
     }
 
-    std::array<long, nBlockTypes> BastetBlockChooser::ComputeMainScores(
-        const Well * well, BlockType currentBlock) {
-        RecursiveVisitor visitor;
-        Searcher(currentBlock, well, BlockPosition(), &visitor);
-        return visitor.GetScores();
+    template<typename G>
+    BastetBlockChooser<G>::BastetBlockChooser(unsigned   threads,
+                                              unsigned   tableBits,
+                                              SearchMode mode, uint64_t seed)
+        : BlockChooser<G>(seed)
+        , _mode(mode)
+        , _pool(threads)
+        , _tables(_pool.GetSize(), TranspositionTable(tableBits))
+        , _book(nullptr)
+        , _specCancel(false)
+        , _specPending(false)
+        , _specRunning(false)
+        , _specStop(false) {}
+
+    template<typename G>
+    BastetBlockChooser<G>::~BastetBlockChooser() noexcept {
+        if (!_speculator.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(_specMutex);
+            _specStop   = true;
+            _specCancel = true;
+        }
+        _specWake.notify_one();
+        _speculator.join();
     }
 
-    BlockType BastetBlockChooser::GetNext(const Well * well, const Queue & q) {
-        auto mainScores  = ComputeMainScores(well, q.front());
-        auto finalScores = mainScores;
+    template<typename G>
+    TranspositionTable::Stats BastetBlockChooser<G>::GetTableStats() const {
+        TranspositionTable::Stats stats{};
+        for (const auto & t : _tables) stats += t.GetStats();
+        return stats;
+    }
 
-        // perturbes scores to randomize tie handling
-        for (auto & i : finalScores) i += (random() % 100);
+    template<typename G>
+    void BastetBlockChooser<G>::ResetTableStats() {
+        for (auto & t : _tables) t.ResetStats();
+    }
+
+    template<typename G>
+    typename BastetBlockChooser<G>::ScoresList
+    BastetBlockChooser<G>::ComputeMainScores(const Well<G> * well,
+                                             BlockType       currentBlock,
+                                             const std::atomic<bool> * cancel) {
+        const BlockPosition start = BlockPosition::Start<G>();
+        if (_pool.GetSize() == 1) {
+            Well<G>             board(*well);  // the only copy
+            RecursiveVisitor<G> visitor(&_tables[0], cancel, _mode);
+            Count(Counter::WellCopies);
+            Searcher<G>(currentBlock, &board, start, &visitor, _mode);
+            return visitor.GetScores();
+        }
+
+        // same as RecursiveVisitor, but each (landing, next block) pair is a
+        // separate job for the pool, and each thread works on its own board
+        std::vector<Well<G>> boards(_pool.GetSize(), *well);
+        Count(Counter::WellCopies, boards.size());
+        LandingsVisitor<G> landings;
+        Searcher<G>(currentBlock, &boards[0], start, &landings, _mode);
+        const auto &      v = landings.GetLandings();
+        std::vector<long> jobScores(v.size() * nBlockTypes);
+        _pool.ParallelFor(jobScores.size(), [&](size_t k, unsigned thread) {
+            if (cancel && *cancel) return;
+            Well<G> &   board = boards[thread];
+            WellUndo<G> undo;
+            int         linescleared = board.TryLockAndClearLines(
+                currentBlock, v[k / nBlockTypes], undo);
+            if (linescleared == Well<G>::LockedOut) {
+                Count(Counter::GameOverPrunes);
+                jobScores[k] = GameOverScore;
+                return;
+            }
+            jobScores[k] = CachedBestScore(&_tables[thread], &board,
+                                           BlockType(k % nBlockTypes),
+                                           linescleared, _mode);
+            board.Undo(undo);
+        });
+
+        // max is exact, so this gives the same scores as the serial version
+        ScoresList scores;
+        scores.fill(GameOverScore);
+        for (size_t k = 0; k < jobScores.size(); ++k)
+            scores[k % nBlockTypes]
+                = max(scores[k % nBlockTypes], jobScores[k]);
+        return scores;
+    }
+
+    template<typename G>
+    void BastetBlockChooser<G>::SetOpeningBook(const OpeningBook * book) {
+        _book = book && book->GetSearchMode() == _mode
+                        && book->GetWidth() == G::Width
+                        && book->GetHeight() == G::Height
+                    ? book
+                    : nullptr;
+    }
+
+    template<typename G>
+    void BastetBlockChooser<G>::Speculate(const Well<G> * well,
+                                          const Queue &   q) {
+        if (q.empty()) return;
+        ScoresList scores;
+        if (_book && _book->Lookup(well->GetHash(), q.front(), scores)) return;
+        std::lock_guard<std::mutex> lock(_specMutex);
+        if (!_speculator.joinable())
+            _speculator
+                = std::thread(&BastetBlockChooser::SpeculationLoop, this);
+
+        // already requested, or already done?
+        if ((_specPending || _specRunning) && _specRequest.block == q.front()
+            && _specRequest.well == *well)
+            return;
+        for (const auto & s : _specResults)
+            if (s.block == q.front() && s.well == *well) return;
+
+        _specRequest.well  = *well;
+        _specRequest.block = q.front();
+        _specPending       = true;
+        Count(Counter::WellCopies);
+        if (_specRunning) _specCancel = true;
+        _specWake.notify_one();
+    }
+
+    template<typename G>
+    void BastetBlockChooser<G>::SpeculationLoop() {
+        std::unique_lock<std::mutex> lock(_specMutex);
+        while (true) {
+            _specWake.wait(lock, [&] { return _specStop || _specPending; });
+            if (_specStop) return;
+            Speculation s = _specRequest;
+            Count(Counter::WellCopies);
+            _specPending = false;
+            _specRunning = true;
+            _specCancel  = false;
+            lock.unlock();
+            s.scores = ComputeMainScores(&s.well, s.block, &_specCancel);
+            lock.lock();
+            _specRunning = false;
+            if (!_specCancel) {
+                _specResults.push_front(s);
+                if (_specResults.size() > SpeculationsKept)
+                    _specResults.pop_back();
+            }
+            _specDone.notify_all();
+        }
+    }
 
-        // prints the final scores, for debugging convenience
-        for (size_t i = 0; i < nBlockTypes; ++i) {
-            // mvprintw(i,1,"%c: %d",GetChar(BlockType(i)),finalScores[i]);
+    template<typename G>
+    bool BastetBlockChooser<G>::TakeSpeculation(const Well<G> * well,
+                                                BlockType       block,
+                                                ScoresList &    scores) {
+        if (!_speculator.joinable()) return false;
+        std::unique_lock<std::mutex> lock(_specMutex);
+        // lets the thread finish only if it is working on the right well
+        if (_specRequest.block != block || !(_specRequest.well == *well)) {
+            _specPending = false;
+            if (_specRunning) _specCancel = true;
+        }
+        _specDone.wait(lock, [&] { return !_specPending && !_specRunning; });
+        bool found = false;
+        for (const auto & s : _specResults) {
+            if (s.block == block && s.well == *well) {
+                scores = s.scores;
+                found  = true;
+                break;
+            }
         }
+        // the turn is over: the block is locked and the wells it could leave
+        // hardly ever come back, so the other landings are stale
+        _specResults.clear();
+        return found;
+    }
+
+    template<typename G>
+    typename BastetBlockChooser<G>::ScoresList
+    BastetBlockChooser<G>::MainScores(const Well<G> * well, BlockType block) {
+        ScoresList scores;
+        if (_book && _book->Lookup(well->GetHash(), block, scores)) {
+            Count(Counter::BookHits);
+            return scores;
+        }
+        if (!TakeSpeculation(well, block, scores))
+            scores = ComputeMainScores(well, block);
+        return scores;
+    }
+
+    template<typename G>
+    BlockType BastetBlockChooser<G>::GetNext(const Well<G> * well,
+                                             const Queue &   q) {
+        GetNextTimer timer;
+        return ChooseBlock(MainScores(well, q.front()), q.front());
+    }
+
+    template<typename G>
+    BlockType BastetBlockChooser<G>::ChooseBlock(ScoresList mainScores,
+                                                 BlockType  current) {
+        auto finalScores = mainScores;
+
+        // perturbes scores to randomize tie handling
+        for (auto & i : finalScores) i += this->_random.Below(100);
 
         // the mainScores alone would give rise to many repeated blocks (e.g.,
         // in the case in which only one type of block does not let you clear a
@@ -112,7 +301,7 @@ namespace Bastet {
         // always returns the worst block if it's different from the last one
         auto worstblock = find(finalScores.begin(), finalScores.end(), temp[0])
                           - finalScores.begin();
-        if (BlockType(worstblock) != q.front()) {
+        if (BlockType(worstblock) != current) {
             return BlockType(worstblock);
         }
 
@@ -120,7 +309,8 @@ namespace Bastet {
         static const std::array<int, nBlockTypes> blockPercentages
             = {{80, 92, 98, 100, 100, 100, 100}};
         auto pos = find_if(blockPercentages.begin(), blockPercentages.end(),
-                           bind2nd(greater_equal<int>(), random() % 100))
+                           bind2nd(greater_equal<int>(),
+                                   this->_random.Below(100)))
                    - blockPercentages.begin();
         assert(pos >= 0 && pos < nBlockTypes);
 
@@ -131,64 +321,347 @@ namespace Bastet {
 
         // return
         // BlockType(min_element(finalScores.begin(),finalScores.end())-finalScores.begin());
-        // return BlockType(random()%7);
+        // return BlockType(this->_random.Below(7));
+    }
+
+    // the landings of b in w, the most promising (by Evaluate) first, so
+    // that the alpha-beta search can cut the others early
+    template<typename G>
+    static std::vector<Vertex> OrderedLandings(Well<G> * w, BlockType b,
+                                               SearchMode mode) {
+        LandingsVisitor<G> landings;
+        Searcher<G>(b, w, BlockPosition::Start<G>(), &landings, mode);
+        std::vector<std::pair<long, Vertex>> scored;
+        for (const Vertex & v : landings.GetLandings()) {
+            WellUndo<G> undo;
+            int         linescleared = w->TryLockAndClearLines(b, v, undo);
+            if (linescleared == Well<G>::LockedOut) {
+                Count(Counter::GameOverPrunes);
+                continue;
+            }
+            scored.emplace_back(Evaluate(w, linescleared), v);
+            w->Undo(undo);
+        }
+        std::stable_sort(scored.begin(), scored.end(),
+                         [](const std::pair<long, Vertex> & a,
+                            const std::pair<long, Vertex> & b) {
+                             return a.first > b.first;
+                         });
+        std::vector<Vertex> ordered;
+        ordered.reserve(scored.size());
+        for (const auto & s : scored) ordered.push_back(s.second);
+        return ordered;
+    }
+
+    template<typename G>
+    DeepBlockChooser<G>::DeepBlockChooser(Clock::duration budget, int maxDepth,
+                                          unsigned threads, unsigned tableBits,
+                                          SearchMode mode, uint64_t seed)
+        : BastetBlockChooser<G>(threads, tableBits, mode, seed)
+        , _budget(budget)
+        , _maxDepth(maxDepth)
+        , _lastDepth(0)
+        , _table(tableBits)
+        , _timedOut(false) {}
+
+    template<typename G>
+    TranspositionTable::Stats DeepBlockChooser<G>::GetTableStats() const {
+        TranspositionTable::Stats stats
+            = BastetBlockChooser<G>::GetTableStats();
+        stats += _table.GetStats();
+        return stats;
     }
 
-    Searcher::Searcher(BlockType b, const Well * well, Vertex v,
-                       WellVisitor * visitor)
-        : _block(b), _well(well), _visitor(visitor) {
-        DFSVisit(v);
+    template<typename G>
+    void DeepBlockChooser<G>::ResetTableStats() {
+        BastetBlockChooser<G>::ResetTableStats();
+        _table.ResetStats();
     }
 
-    void Searcher::DFSVisit(Vertex v) {
-        if (_visited.insert(v).second == false) return;  // already visited
+    template<typename G>
+    BlockType DeepBlockChooser<G>::GetNext(const Well<G> * well,
+                                           const Queue &   q) {
+        GetNextTimer            timer;
+        const Clock::time_point deadline   = Clock::now() + _budget;
+        ScoresList              mainScores = this->MainScores(well, q.front());
+
+        _lastDepth = 2;
+        ScoresList scores;
+        for (int depth = 3; depth <= _maxDepth; ++depth) {
+            if (!ComputeDeepScores(well, q.front(), depth, deadline, scores))
+                break;
+            mainScores = scores;
+            _lastDepth = depth;
+        }
+        return this->ChooseBlock(mainScores, q.front());
+    }
 
-        for (int i = 0; i < 5; ++i) {
-            Vertex v2(v);
-            if (v2.MoveIfPossible(Movement(i), _block, _well))
-                DFSVisit(v2);
-            else {
-                if (Movement(i) == Down)  // block may lock here
-                    _visitor->Visit(_block, _well, v);
+    template<typename G>
+    bool DeepBlockChooser<G>::ComputeDeepScores(const Well<G> *   well,
+                                                BlockType         currentBlock,
+                                                int               depth,
+                                                Clock::time_point deadline,
+                                                ScoresList &      scores) {
+        _deadline = deadline;
+        _timedOut = false;
+        if (TimedOut()) return false;
+        Well<G> board(*well);  // the only copy
+        Count(Counter::WellCopies);
+        scores.fill(GameOverScore);
+        for (const Vertex & v :
+             OrderedLandings(&board, currentBlock, this->GetSearchMode())) {
+            WellUndo<G> undo;
+            int         linescleared
+                = board.TryLockAndClearLines(currentBlock, v, undo);
+            if (linescleared == Well<G>::LockedOut) continue;
+            for (size_t i = 0; i < nBlockTypes; ++i)
+                scores[i] = max(scores[i],
+                                PlayerScore(&board, BlockType(i), depth - 1,
+                                            linescleared, scores[i],
+                                            numeric_limits<long>::max()));
+            board.Undo(undo);
+            if (_timedOut) return false;
+        }
+        return true;
+    }
+
+    template<typename G>
+    long DeepBlockChooser<G>::PlayerScore(Well<G> * w, BlockType b, int depth,
+                                          int bonusLines, long alpha,
+                                          long beta) {
+        const SearchMode mode = this->GetSearchMode();
+        if (TimedOut()) return GameOverScore;  // will be thrown away
+        if (depth == 1)
+            return CachedBestScore(&_table, w, b, bonusLines, mode);
+        if (!BlockPosition::Start<G>().IsValid(b, w)) return GameOverScore;
+        long best = GameOverScore;
+        for (const Vertex & v : OrderedLandings(w, b, mode)) {
+            WellUndo<G> undo;
+            int         linescleared = w->TryLockAndClearLines(b, v, undo);
+            if (linescleared == Well<G>::LockedOut) continue;
+            best = max(best,
+                       ChooserScore(w, depth - 1, bonusLines + linescleared,
+                                    max(alpha, best), beta));
+            w->Undo(undo);
+            if (best >= beta) break;  // the chooser will avoid this anyway
+        }
+        return best;
+    }
+
+    template<typename G>
+    long DeepBlockChooser<G>::ChooserScore(Well<G> * w, int depth,
+                                           int bonusLines, long alpha,
+                                           long beta) {
+        static const BlockType order[nBlockTypes] = {S, Z, O, T, L, J, I};
+        long worst = numeric_limits<long>::max();
+        for (BlockType b : order) {
+            worst = min(worst, PlayerScore(w, b, depth, bonusLines,
+                                           alpha, min(beta, worst)));
+            if (worst <= alpha) break;  // the player will avoid this anyway
+        }
+        return worst;
+    }
+
+    template<typename G>
+    bool DeepBlockChooser<G>::TimedOut() {
+        if (!_timedOut && Clock::now() >= _deadline) _timedOut = true;
+        return _timedOut;
+    }
+
+    template<typename G>
+    Searcher<G>::Searcher(BlockType b, Well<G> * well, Vertex v,
+                          WellVisitor<G> * visitor, SearchMode mode)
+        : _block(b),
+          _well(well),
+          _visitor(visitor),
+          _landings(0),
+          _duplicates(0) {
+        if (mode == SearchMode::HardDrop)
+            DropVisit();
+        else
+            FloodFill(v);
+    }
+
+    template<typename G>
+    size_t Searcher<G>::Index(const Vertex & v) {
+        const Dot & pos = v.GetPos();
+        assert(pos.x >= -WallWidth && pos.x < G::Width);
+        assert(pos.y >= MinY && pos.y < G::Height);
+        return (size_t(v.GetOrientation()) * Rows + (pos.y - MinY)) * Columns
+               + (pos.x + WallWidth);
+    }
+
+    template<typename G>
+    void Searcher<G>::ValidPositions(Orientation o, Plane & valid) {
+        const BlockShape & s = blocks[_block].GetShape(o);
+        // bit dx of pattern[dy] is set for each dot (dx,dy) of the block
+        const auto & pattern = s.lines;
+        for (int y = MinY; y < G::Height; ++y) {
+            Line free = AllColumns;
+            for (int dy = s.min.y; dy <= s.max.y && free; ++dy) {
+                if (!_well->IsValidLine(y + dy)) {
+                    free = 0;
+                    break;
+                }
+                // the block fits at x if every dot x+dx is empty: shifts the
+                // empty dots of the line back by dx, for each dot
+                const Line empty = ~_well->GetLine(y + dy);
+                for (unsigned dots = pattern[dy]; dots != 0; dots &= dots - 1)
+                    free &= empty >> __builtin_ctz(dots);
             }
+            valid[y - MinY] = free;
         }
     }
 
-    BestScoreVisitor::BestScoreVisitor(int bonusLines)
-        : _score(GameOverScore), _bonusLines(bonusLines){};
+    template<typename G>
+    void Searcher<G>::FloodFill(const Vertex & v) {
+        std::array<Plane, Orientation::Number> valid, reached;
+        for (size_t o = 0; o < Orientation::Number; ++o) {
+            ValidPositions(o, valid[o]);
+            reached[o].fill(0);
+        }
+        // the starting position counts as reached, even if it is not valid
+        const size_t first = Index(v) / Columns % Rows;
+        reached[v.GetOrientation()][first]
+            = Line(1u << (v.GetPos().x + WallWidth));
+
+        // no move goes up, so a single pass from the top is enough: each row
+        // gets all it can reach by Left, Right and the rotations, then what
+        // can move Down goes to the next row, and the rest locks
+        for (size_t row = first; row < Rows; ++row) {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (size_t o = 0; o < Orientation::Number; ++o) {
+                    const Line fits = valid[o][row];
+                    Line       r    = reached[o][row];
+                    r |= (reached[(o + 1) % 4][row] | reached[(o + 3) % 4][row])
+                         & fits;
+                    for (Line grown = r;; r = grown) {
+                        grown = r | (((r << 1) | (r >> 1)) & fits);
+                        if (grown == r) break;
+                    }
+                    if (r != reached[o][row]) {
+                        reached[o][row] = r;
+                        changed         = true;
+                    }
+                }
+            }
+            if (StatsEnabled)
+                for (size_t o = 0; o < Orientation::Number; ++o)
+                    Count(Counter::Vertices,
+                          __builtin_popcount(reached[o][row]));
+            bool more = false;
+            for (size_t o = 0; o < Orientation::Number; ++o) {
+                const Line below = row + 1 < Rows ? valid[o][row + 1] : 0;
+                for (unsigned locks = reached[o][row] & ~below; locks != 0;
+                     locks &= locks - 1) {
+                    const int x = __builtin_ctz(locks) - WallWidth;
+                    Land(Vertex(Dot{x, int(row) + MinY}, Orientation(o)));
+                }
+                if (row + 1 < Rows) {
+                    reached[o][row + 1] = reached[o][row] & below;
+                    more                = more || reached[o][row + 1];
+                }
+            }
+            if (!more) break;
+        }
+    }
 
-    void BestScoreVisitor::Visit(BlockType b, const Well * w, Vertex v) {
-        Well w2(*w);  // copy
-        try {
-            int  linescleared = w2.LockAndClearLines(b, v);
-            long thisscore    = Evaluate(&w2, linescleared + _bonusLines);
-            _score            = max(_score, thisscore);
-        } catch (const GameOver & go) {}
-    }
-
-    void RecursiveVisitor::Visit(BlockType b, const Well * w, Vertex v) {
-        Well w2(*w);  // copy
-        try {
-            int linescleared = w2.LockAndClearLines(b, v);  // may throw GO
-            for (size_t i = 0; i < nBlockTypes; ++i) {
-                try {
-                    BestScoreVisitor visitor(linescleared);
-                    BlockPosition    p;
-                    if (!p.IsValid(BlockType(i), &w2)) throw(GameOver());
-                    Searcher searcher(BlockType(i), &w2, p, &visitor);
-                    _scores[i] = max(_scores[i], visitor.GetScore());
-                } catch (const GameOver & go) {}
+    template<typename G>
+    void Searcher<G>::DropVisit() {
+        for (size_t o = 0; o < Orientation::Number; ++o) {
+            const BlockShape & s = blocks[_block].GetShape(o);
+            if (s.canonical != o) continue;  // same drops as the canonical one
+            for (int x = -s.min.x; x + s.max.x < G::Width; ++x) {
+                // the highest y where no column of the block rests on the
+                // column of the well below it
+                int y = G::Height;
+                for (int dx = s.min.x; dx <= s.max.x; ++dx) {
+                    const int top
+                        = G::Height - _well->GetColumnHeight(x + dx);
+                    y = std::min(y, top - 1 - s.bottom[dx]);
+                }
+                const Vertex v(Dot{x, y}, o);
+                Count(Counter::Vertices);
+                if (_well->Accomodates(_block, v)) Land(v);
             }
-        } catch (const GameOver & go) {
-        }  // catches the exception which might be thrown by LockAndClearLines
+        }
     }
 
-    Queue NoPreviewBlockChooser::GetStartingQueue() {
+    template<typename G>
+    void Searcher<G>::Land(const Vertex & v) {
+        const BlockShape & s = v.GetShape(_block);
+        const size_t       index
+            = Index(Vertex(v.GetPos() + s.offset, s.canonical));
+        if (_landed[index]) {
+            ++_duplicates;
+            return;
+        }
+        _landed.set(index);
+        ++_landings;
+        Count(Counter::Visits);
+        _visitor->Visit(_block, _well, v);
+    }
+
+    template<typename G>
+    BestScoreVisitor<G>::BestScoreVisitor(int bonusLines)
+        : _score(GameOverScore), _bonusLines(bonusLines){};
+
+    // the two visitors below lock into a copy of the well rather than lock
+    // and Undo in place: the copy is a few dozen bytes, and bastet_bench
+    // times it faster than the undo
+    template<typename G>
+    void BestScoreVisitor<G>::Visit(BlockType b, Well<G> * w, Vertex v) {
+        Well<G> w2(*w);  // copy
+        Count(Counter::WellCopies);
+        int linescleared = w2.TryLockAndClearLines(b, v);
+        if (linescleared == Well<G>::LockedOut) {
+            Count(Counter::GameOverPrunes);
+            return;
+        }
+        long thisscore = Evaluate(&w2, linescleared + _bonusLines);
+        _score         = max(_score, thisscore);
+    }
+
+    template<typename G>
+    long BestScore(Well<G> * w, BlockType b, int bonusLines, SearchMode mode) {
+        BestScoreVisitor<G> visitor(bonusLines);
+        BlockPosition       p = BlockPosition::Start<G>();
+        if (!p.IsValid(b, w)) return GameOverScore;
+        Searcher<G> searcher(b, w, p, &visitor, mode);
+        return visitor.GetScore();
+    }
+
+    template<typename G>
+    void RecursiveVisitor<G>::Visit(BlockType b, Well<G> * w, Vertex v) {
+        if (_cancel && *_cancel) return;
+        Well<G> w2(*w);  // copy
+        Count(Counter::WellCopies);
+        int linescleared = w2.TryLockAndClearLines(b, v);
+        if (linescleared == Well<G>::LockedOut) {
+            Count(Counter::GameOverPrunes);
+            return;
+        }
+        for (size_t i = 0; i < nBlockTypes; ++i)
+            _scores[i] = max(_scores[i], CachedBestScore(_table, &w2,
+                                                         BlockType(i),
+                                                         linescleared, _mode));
+    }
+
+    template<typename G>
+    void LandingsVisitor<G>::Visit(BlockType /*b*/, Well<G> * /*w*/,
+                                   Vertex v) {
+        _landings.push_back(v);
+    }
+
+    template<typename G>
+    Queue NoPreviewBlockChooser<G>::GetStartingQueue() {
         Queue q;
         // The first block is always I,J,L,T (cfr. Tetris guidelines, Bastet is
         // a gentleman and chooses the most favorable start for the user).
         BlockType first;
-        switch (random() % 4) {
+        switch (this->_random.Below(4)) {
             case 0:
                 first = I;
                 break;
@@ -206,18 +679,23 @@ namespace Bastet {
         return q;
     }
 
-    BlockType NoPreviewBlockChooser::GetNext(const Well *  well,
-                                             const Queue & q) {
+    template<typename G>
+    BlockType NoPreviewBlockChooser<G>::GetNext(const Well<G> * well,
+                                                const Queue &   q) {
         assert(q.empty());
+        GetNextTimer                  timer;
         std::array<long, nBlockTypes> finalScores;
+        Well<G>                       board(*well);  // the only copy
+        Count(Counter::WellCopies);
         for (size_t t = 0; t < nBlockTypes; ++t) {
-            BestScoreVisitor v;
-            Searcher         searcher(BlockType(t), well, BlockPosition(), &v);
+            BestScoreVisitor<G> v;
+            Searcher<G>         searcher(BlockType(t), &board,
+                                         BlockPosition::Start<G>(), &v);
             finalScores[t] = v.GetScore();
         }
 
         // perturbes scores to randomize tie handling
-        for (auto & i : finalScores) { i += random() % 100; }
+        for (auto & i : finalScores) { i += this->_random.Below(100); }
 
         // sorts
         std::array<long, nBlockTypes> temp(finalScores);
@@ -227,7 +705,8 @@ namespace Bastet {
         static const std::array<int, nBlockTypes> blockPercentages
             = {{80, 92, 98, 100, 100, 100, 100}};
         auto pos = find_if(blockPercentages.begin(), blockPercentages.end(),
-                           bind2nd(greater_equal<int>(), random() % 100))
+                           bind2nd(greater_equal<int>(),
+                                   this->_random.Below(100)))
                    - blockPercentages.begin();
         assert(pos >= 0 && pos < nBlockTypes);
 
@@ -237,4 +716,21 @@ namespace Bastet {
         return BlockType(chosenBlock);
     }
 
+#define INSTANTIATE(G)                                                         \
+    template long Evaluate(const Well<G> * w, int extralines);                 \
+    template long BestScore(Well<G> * w, BlockType b, int bonusLines,          \
+                            SearchMode mode);                                  \
+    template long CachedBestScore(TranspositionTable * table, Well<G> * w,     \
+                                  BlockType b, int bonusLines,                 \
+                                  SearchMode mode);                            \
+    template class RecursiveVisitor<G>;                                        \
+    template class BestScoreVisitor<G>;                                        \
+    template class LandingsVisitor<G>;                                         \
+    template class Searcher<G>;                                                \
+    template class BastetBlockChooser<G>;                                      \
+    template class DeepBlockChooser<G>;                                        \
+    template class NoPreviewBlockChooser<G>;
+    BASTET_GEOMETRIES(INSTANTIATE)
+#undef INSTANTIATE
+
 }  // namespace Bastet
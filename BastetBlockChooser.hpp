@@ -20,10 +20,18 @@
 #define BASTET_BLOCK_CHOOSER_HPP
 
 #include <array>
-#include <boost/functional/hash.hpp>
-#include <boost/unordered_set.hpp>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "BlockChooser.hpp"
+#include "ThreadPool.hpp"
+#include "TranspositionTable.hpp"
 #include "Well.hpp"
 
 namespace Bastet {
@@ -31,42 +39,76 @@ namespace Bastet {
     // bogus score assigned to combinations which cause game over
     static constexpr long GameOverScore = -1000;
 
-    //  declared in Well.hpp
     // assigns a score to a position w + a number of extra
     // lines deleted while getting there
-    long Evaluate(const Well * w, int extralines = 0);
+    template<typename G>
+    long Evaluate(const Well<G> * w, int extralines = 0);
 
     typedef BlockPosition Vertex;
 
-    // generic visitor that "does something" with a possible drop position
+    // how the drop positions of a block are looked for
+    enum class SearchMode {
+        Exact,    // all the reachable ones, with tucks and spins
+        HardDrop  // each orientation and column dropped straight down: much
+                  // faster, but it misses the positions under overhangs
+    };
+
+    // generic visitor that "does something" with a possible drop position.
+    // It may modify the well (e.g. lock the block there and search further),
+    // as long as it restores it before returning.
+    template<typename G>
     class WellVisitor {
        public:
         virtual ~WellVisitor() noexcept = default;
 
-        virtual void Visit(BlockType b, const Well * well, Vertex v) = 0;
+        virtual void Visit(BlockType b, Well<G> * well, Vertex v) = 0;
     };
 
+    // max score over all drop positions of block b in well w (with bonusLines
+    // lines already cleared), or GameOverScore if b does not fit into w at all.
+    // w is used as scratch space, and restored before returning.
+    template<typename G>
+    long BestScore(Well<G> * w, BlockType b, int bonusLines = 0,
+                   SearchMode mode = SearchMode::Exact);
+
+    // BestScore, but looked up in (and stored into) table if there is one
+    template<typename G>
+    long CachedBestScore(TranspositionTable * table, Well<G> * w, BlockType b,
+                         int bonusLines, SearchMode mode = SearchMode::Exact);
+
     // for each block type, drops it (via a BestScoreVisitor) and sees which
     // block reaches the best score along the drop positions
-    class RecursiveVisitor : public WellVisitor {
+    // if given a table, looks up there the scores of the second-level drops;
+    // stops visiting (leaving the scores incomplete) as soon as *cancel is set
+    template<typename G>
+    class RecursiveVisitor : public WellVisitor<G> {
        public:
-        RecursiveVisitor() { _scores.fill(GameOverScore); }
+        explicit RecursiveVisitor(TranspositionTable *      table  = nullptr,
+                                  const std::atomic<bool> * cancel = nullptr,
+                                  SearchMode mode = SearchMode::Exact)
+            : _table(table), _cancel(cancel), _mode(mode) {
+            _scores.fill(GameOverScore);
+        }
         virtual ~RecursiveVisitor() noexcept override = default;
-        virtual void Visit(BlockType b, const Well * well, Vertex v);
+        virtual void Visit(BlockType b, Well<G> * well, Vertex v);
 
         using ScoresList = std::array<long, 7>;
         const ScoresList & GetScores() const { return _scores; }
 
        private:
-        ScoresList _scores;
+        ScoresList                _scores;
+        TranspositionTable *      _table;
+        const std::atomic<bool> * _cancel;
+        SearchMode                _mode;  // for the second level
     };
 
     // returns the max score over all drop positions
-    class BestScoreVisitor : public WellVisitor {
+    template<typename G>
+    class BestScoreVisitor : public WellVisitor<G> {
        public:
         explicit BestScoreVisitor(int bonusLines = 0);
         virtual ~BestScoreVisitor() noexcept override = default;
-        virtual void Visit(BlockType b, const Well * well, Vertex v);
+        virtual void Visit(BlockType b, Well<G> * well, Vertex v);
         long         GetScore() const { return _score; }
 
        private:
@@ -74,49 +116,229 @@ namespace Bastet {
         int  _bonusLines;
     };
 
+    // just stores the drop positions, to be processed later
+    template<typename G>
+    class LandingsVisitor : public WellVisitor<G> {
+       public:
+        virtual ~LandingsVisitor() noexcept override = default;
+        virtual void Visit(BlockType b, Well<G> * well, Vertex v);
+
+        const std::vector<Vertex> & GetLandings() const { return _landings; }
+
+       private:
+        std::vector<Vertex> _landings;
+    };
+
     /**
      * Tries to drop a block in all possible positions, and invokes the visitor
-     * on each one
+     * on each one: every position where block b can lock when it starts from
+     * v, or with SearchMode::HardDrop only those reached by a straight drop.
+     * Positions covering the same dots (e.g. the four orientations of the O)
+     * leave the same well, so only the first of them is visited.
      */
+    template<typename G>
     class Searcher {
        public:
-        Searcher(BlockType b, const Well * well, Vertex v,
-                 WellVisitor * visitor);
+        Searcher(BlockType b, Well<G> * well, Vertex v,
+                 WellVisitor<G> * visitor, SearchMode mode = SearchMode::Exact);
+
+        /// number of distinct locked positions which were visited
+        size_t GetLandings() const { return _landings; }
+
+        /// number of locked positions skipped as duplicates of another one
+        size_t GetDuplicates() const { return _duplicates; }
 
        private:
-        boost::unordered_set<Vertex> _visited;
-        // std::set<Vertex> _visited; ^^ the above is more efficient, we need to
-        // do many inserts
-        BlockType     _block;
-        const Well *  _well;
-        WellVisitor * _visitor;
-        void          DFSVisit(Vertex v);
+        // every valid position has x in [-WallWidth,G::Width) and
+        // y in [-5,G::Height), which gives a small, dense vertex space
+        static constexpr int    MinY    = -5;
+        static constexpr int    Columns = G::Width + WallWidth;
+        static constexpr int    Rows    = G::Height - MinY;
+        static constexpr size_t MaxVertices
+            = Orientation::Number * Rows * Columns;
+
+        static size_t Index(const Vertex & v);
+
+        // a set of positions of the block in one orientation: bit
+        // x+WallWidth of row y-MinY stands for the block at (x,y)
+        using Line  = typename G::Line;
+        using Plane = std::array<Line, Rows>;
+        static constexpr Line AllColumns = (1u << Columns) - 1;
+
+        // landings, indexed by their canonical vertex (see BlockShape)
+        std::bitset<MaxVertices> _landed;
+        BlockType                _block;
+        Well<G> *                _well;
+        WellVisitor<G> *         _visitor;
+        size_t                   _landings;
+        size_t                   _duplicates;
+        void                     ValidPositions(Orientation o, Plane & valid);
+        void                     FloodFill(const Vertex & v);
+        void                     DropVisit();
+        void                     Land(const Vertex & v);
     };
 
-    class BastetBlockChooser : public BlockChooser {
+    class OpeningBook;
+
+    template<typename G>
+    class BastetBlockChooser : public BlockChooser<G> {
        public:
-        virtual ~BastetBlockChooser() noexcept = default;
+        /// with more than one thread, the second-level searches of
+        /// ComputeMainScores are spread over a pool of that size. Each thread
+        /// caches their results in a table of 2^tableBits entries
+        explicit BastetBlockChooser(
+            unsigned   threads   = 1,
+            unsigned   tableBits = TranspositionTable::DefaultLog2Size,
+            SearchMode mode      = SearchMode::Exact,
+            uint64_t   seed      = NewSeed());
+        virtual ~BastetBlockChooser() noexcept;
 
         virtual Queue     GetStartingQueue();
-        virtual BlockType GetNext(const Well * well, const Queue & q);
+        virtual BlockType GetNext(const Well<G> * well, const Queue & q);
+        /// computes the main scores for (well, q.front()) in a background
+        /// thread; GetNext uses them if it is then called with the same well
+        /// and block, otherwise it cancels them and searches by itself
+        virtual void Speculate(const Well<G> * well, const Queue & q);
         /**
          * computes "scores" of the candidate next blocks by dropping them in
          * all possible positions and choosing the one that has the least
          * max_(drop positions) Evaluate(well)
          */
-        std::array<long, 7> ComputeMainScores(const Well * well,
-                                              BlockType    currentBlock);
+        std::array<long, 7> ComputeMainScores(const Well<G> * well,
+                                              BlockType       currentBlock) {
+            return ComputeMainScores(well, currentBlock, nullptr);
+        }
+
+        /// hit-rate statistics of the tables, summed over all threads
+        virtual TranspositionTable::Stats GetTableStats() const;
+        virtual void                      ResetTableStats();
+
+        SearchMode GetSearchMode() const { return _mode; }
+        /// looks the main scores up in book (which must outlive the chooser)
+        /// before searching them; a book of another search mode or another
+        /// geometry is ignored
+        void SetOpeningBook(const OpeningBook * book);
+
+       protected:
+        using ScoresList = typename RecursiveVisitor<G>::ScoresList;
+
+        /// the main scores of (well, block): from the opening book, from the
+        /// speculation thread, or else searched
+        ScoresList MainScores(const Well<G> * well, BlockType block);
+
+        /// the block to give, from the main scores of the candidates and the
+        /// block currently falling
+        BlockType ChooseBlock(ScoresList mainScores, BlockType current);
+        /// waits for the speculation thread to be idle (cancelling what it is
+        /// doing unless it is about (well, block)), then looks for a result.
+        /// Ends the turn: all the results are dropped
+        bool TakeSpeculation(const Well<G> * well, BlockType block,
+                             ScoresList & scores);
 
        private:
+        ScoresList ComputeMainScores(const Well<G> * well,
+                                     BlockType       currentBlock,
+                                     const std::atomic<bool> * cancel);
+
+        SearchMode                      _mode;
+        ThreadPool                      _pool;
+        std::vector<TranspositionTable> _tables;  // one per thread
+        const OpeningBook *             _book;
+
+        // background computation of the main scores, see Speculate
+        struct Speculation {
+            Well<G>    well;
+            BlockType  block;
+            ScoresList scores;
+        };
+        // how many completed speculations are remembered within a turn
+        static constexpr size_t SpeculationsKept = 8;
+
+        void SpeculationLoop();
+
+        std::thread             _speculator;  // started by the first Speculate
+        std::mutex              _specMutex;   // guards all the _spec* members
+        std::condition_variable _specWake;    // a request has arrived
+        std::condition_variable _specDone;    // the thread is idle
+        std::atomic<bool>       _specCancel;  // the current one is outdated
+        Speculation             _specRequest;  // pending or running one
+        bool                    _specPending;
+        bool                    _specRunning;
+        bool                    _specStop;
+        std::deque<Speculation> _specResults;  // most recent first
+    };
+
+    /**
+     * a BastetBlockChooser which looks further ahead: after the current
+     * block, the player drops each block where it is best for them and the
+     * chooser answers with the worst one, up to maxDepth blocks in all. The
+     * search deepens one block at a time while the time budget lasts, and the
+     * deepest completed one gives the scores. The usual two-block search is
+     * always completed, whatever the budget.
+     */
+    template<typename G>
+    class DeepBlockChooser : public BastetBlockChooser<G> {
+       public:
+        using Clock      = std::chrono::steady_clock;
+        using ScoresList = typename BastetBlockChooser<G>::ScoresList;
+
+        static constexpr int DefaultMaxDepth = 8;
+
+        explicit DeepBlockChooser(
+            Clock::duration budget,
+            int             maxDepth  = DefaultMaxDepth,
+            unsigned        threads   = 1,
+            unsigned        tableBits = TranspositionTable::DefaultLog2Size,
+            SearchMode      mode      = SearchMode::Exact,
+            uint64_t        seed      = NewSeed());
+        virtual ~DeepBlockChooser() noexcept = default;
+
+        virtual BlockType GetNext(const Well<G> * well, const Queue & q);
+        /**
+         * the main scores of ComputeMainScores, but searched depth blocks
+         * deep, counting the current one (depth 2 gives the same scores).
+         * Returns false, leaving scores unspecified, if the deadline passes
+         * before the search is over
+         */
+        bool ComputeDeepScores(const Well<G> * well, BlockType currentBlock,
+                               int depth, Clock::time_point deadline,
+                               ScoresList & scores);
+        /// the depth of the search used by the last GetNext
+        int  GetLastDepth() const { return _lastDepth; }
+        void SetMaxDepth(int maxDepth) { _maxDepth = maxDepth; }
+
+        /// those of BastetBlockChooser, plus the table of the deep search
+        virtual TranspositionTable::Stats GetTableStats() const;
+        virtual void                      ResetTableStats();
+
+       private:
+        // alpha-beta search: the best score the player can get from dropping
+        // b in w and then facing depth-1 more blocks, and the score of the
+        // worst block the chooser can give with depth blocks still to go
+        long PlayerScore(Well<G> * w, BlockType b, int depth, int bonusLines,
+                         long alpha, long beta);
+        long ChooserScore(Well<G> * w, int depth, int bonusLines, long alpha,
+                          long beta);
+        bool TimedOut();
+
+        Clock::duration    _budget;
+        int                _maxDepth;
+        int                _lastDepth;
+        TranspositionTable _table;  // for the last block of the search
+        Clock::time_point  _deadline;
+        bool               _timedOut;
     };
 
     // block chooser similar to the older bastet versions, does not give a block
     // preview
-    class NoPreviewBlockChooser : public BlockChooser {
+    template<typename G>
+    class NoPreviewBlockChooser : public BlockChooser<G> {
        public:
+        explicit NoPreviewBlockChooser(uint64_t seed = NewSeed())
+            : BlockChooser<G>(seed) {}
         virtual ~NoPreviewBlockChooser() noexcept = default;
         virtual Queue     GetStartingQueue();
-        virtual BlockType GetNext(const Well * well, const Queue & q);
+        virtual BlockType GetNext(const Well<G> * well, const Queue & q);
     };
 
 }  // namespace Bastet
@@ -0,0 +1,431 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// benchmarks for the engine hot path, from the basic well operations up to
+// the block choosers. Prints a table, or JSON with --json, so that the
+// results of different versions can be compared.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BastetBlockChooser.hpp"
+#include "Well.hpp"
+
+using namespace Bastet;
+using namespace std;
+
+namespace {
+
+    // all the measures are on the standard well
+    using G = StandardGeometry;
+
+    // the second level of the search as it was before Well::TryLock, with the
+    // game over signalled by an exception
+    class ThrowingBestScoreVisitor : public WellVisitor<G> {
+       public:
+        explicit ThrowingBestScoreVisitor(int bonusLines)
+            : _score(GameOverScore), _bonusLines(bonusLines) {}
+        virtual void Visit(BlockType b, Well<G> * w, Vertex v) {
+            Well<G> w2(*w);
+            try {
+                int linescleared = w2.LockAndClearLines(b, v);
+                _score = max(_score, Evaluate(&w2, linescleared + _bonusLines));
+            } catch (const GameOver & go) {}
+        }
+        long GetScore() const { return _score; }
+
+       private:
+        long _score;
+        int  _bonusLines;
+    };
+
+    class ThrowingRecursiveVisitor : public WellVisitor<G> {
+       public:
+        ThrowingRecursiveVisitor() { _scores.fill(GameOverScore); }
+        virtual void Visit(BlockType b, Well<G> * w, Vertex v) {
+            Well<G> w2(*w);
+            try {
+                int linescleared = w2.LockAndClearLines(b, v);
+                for (size_t i = 0; i < nBlockTypes; ++i) {
+                    try {
+                        ThrowingBestScoreVisitor visitor(linescleared);
+                        BlockPosition            p = BlockPosition::Start<G>();
+                        if (!p.IsValid(BlockType(i), &w2)) throw(GameOver());
+                        Searcher<G> searcher(BlockType(i), &w2, p, &visitor);
+                        _scores[i] = max(_scores[i], visitor.GetScore());
+                    } catch (const GameOver & go) {}
+                }
+            } catch (const GameOver & go) {}
+        }
+        const RecursiveVisitor<G>::ScoresList & GetScores() const {
+            return _scores;
+        }
+
+       private:
+        RecursiveVisitor<G>::ScoresList _scores;
+    };
+
+    // counts the landings, and nothing else
+    class CountingVisitor : public WellVisitor<G> {
+       public:
+        CountingVisitor() : _count(0) {}
+        virtual void Visit(BlockType /*b*/, Well<G> * /*w*/, Vertex /*v*/) {
+            ++_count;
+        }
+        size_t GetCount() const { return _count; }
+
+       private:
+        size_t _count;
+    };
+
+    // a small deterministic generator, so that runs can be compared
+    unsigned Rand(unsigned long long & state) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return state >> 33;
+    }
+
+    // plays n games of random drops until they are lost; for each game,
+    // keeps the well halfway through and the one a couple of blocks away
+    // from the end
+    void RandomGames(size_t n, vector<Well<G>> & midgame,
+                     vector<Well<G>> & nearDeath) {
+        const BlockPosition start = BlockPosition::Start<G>();
+        unsigned long long  state = 37;
+        while (nearDeath.size() < n) {
+            vector<Well<G>> history(1);
+            while (true) {
+                BlockType     b = BlockType(Rand(state) % nBlockTypes);
+                BlockPosition p(Dot{int(Rand(state) % G::Width) - 1, -2},
+                                Orientation(Rand(state) % 4));
+                if (!p.IsValid(b, &history.back())) {
+                    if (start.IsValid(b, &history.back()))
+                        continue;  // just a bad spot, try another one
+                    break;
+                }
+                Well<G> w(history.back());
+                p.Drop(b, &w);
+                if (w.TryLockAndClearLines(b, p) == Well<G>::LockedOut) break;
+                history.push_back(w);
+            }
+            if (history.size() > 3) {
+                midgame.push_back(history[history.size() / 2]);
+                nearDeath.push_back(history[history.size() - 3]);
+            }
+        }
+    }
+
+    // every (well, block, landing) reached by the first level of the search
+    struct Landing {
+        Well<G> * well;
+        BlockType block;
+        Vertex    v;
+    };
+
+    vector<Landing> Landings(vector<Well<G>> & wells) {
+        vector<Landing> landings;
+        for (auto & w : wells)
+            for (size_t b = 0; b < nBlockTypes; ++b) {
+                LandingsVisitor<G> v;
+                Searcher<G>(BlockType(b), &w, BlockPosition::Start<G>(), &v);
+                for (const Vertex & l : v.GetLandings())
+                    landings.push_back(Landing{&w, BlockType(b), l});
+            }
+        return landings;
+    }
+
+    using Clock = chrono::steady_clock;
+
+    double Seconds(Clock::duration d) {
+        return chrono::duration<double>(d).count();
+    }
+
+    struct Result {
+        string name;
+        double nsPerOp;
+    };
+
+    vector<Result>                 results;
+    vector<pair<string, double>>   counters;
+    volatile long                  sink;  // keeps the timed work alive
+
+    // times f, which does ops operations at each call: one call to warm up,
+    // then the fastest of reps calls
+    template<typename F>
+    double Measure(const string & name, size_t ops, F f, int reps = 5) {
+        f();
+        double best = numeric_limits<double>::max();
+        for (int r = 0; r < reps; ++r) {
+            const auto start = Clock::now();
+            f();
+            best = min(best, Seconds(Clock::now() - start));
+        }
+        results.push_back(Result{name, best * 1e9 / ops});
+        return best;
+    }
+
+    // how well the tables of a chooser did over all the wells it searched
+    void AddTableCounters(const string &                    chooser,
+                          const TranspositionTable::Stats & s) {
+        counters.push_back(make_pair(chooser + " table probes", s.probes));
+        counters.push_back(make_pair(chooser + " table hits", s.hits));
+        counters.push_back(make_pair(chooser + " table hit rate", s.HitRate()));
+        counters.push_back(
+            make_pair(chooser + " table evictions", s.evictions));
+    }
+
+    void PrintText() {
+        for (const auto & r : results)
+            printf("%-58s %12.1f ns/op %12.0f ops/s\n", r.name.c_str(),
+                   r.nsPerOp, 1e9 / r.nsPerOp);
+        for (const auto & c : counters)
+            printf("%-58s %12.10g\n", c.first.c_str(), c.second);
+    }
+
+    void PrintJson() {
+        printf("{\n  \"benchmarks\": [\n");
+        for (size_t i = 0; i < results.size(); ++i)
+            printf("    {\"name\": \"%s\", \"ns_per_op\": %.3f, "
+                   "\"ops_per_sec\": %.1f}%s\n",
+                   results[i].name.c_str(), results[i].nsPerOp,
+                   1e9 / results[i].nsPerOp,
+                   i + 1 < results.size() ? "," : "");
+        printf("  ],\n  \"counters\": {\n");
+        for (size_t i = 0; i < counters.size(); ++i)
+            printf("    \"%s\": %.10g%s\n", counters[i].first.c_str(),
+                   counters[i].second, i + 1 < counters.size() ? "," : "");
+        printf("  }\n}\n");
+    }
+
+}  // namespace
+
+int main(int argc, char ** argv) {
+    bool     json      = false;
+    unsigned tableBits = TranspositionTable::DefaultLog2Size;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--json")) {
+            json = true;
+        } else if (!strcmp(argv[i], "--table-bits") && i + 1 < argc) {
+            tableBits = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--json] [--table-bits bits]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    const BlockPosition start = BlockPosition::Start<G>();
+    vector<Well<G>>     empty(1), midgame, nearDeath;
+    RandomGames(20, midgame, nearDeath);
+    vector<Well<G>> all(empty);
+    all.insert(all.end(), midgame.begin(), midgame.end());
+    all.insert(all.end(), nearDeath.begin(), nearDeath.end());
+
+    // basic operations, on every position of every block in the midgame wells
+    const size_t positions = midgame.size() * nBlockTypes
+                             * Orientation::Number * (G::Width + WallWidth)
+                             * (G::Height + 5);
+    Measure("Well::Accomodates", positions, [&] {
+        long n = 0;
+        for (const auto & w : midgame)
+            for (size_t b = 0; b < nBlockTypes; ++b)
+                for (size_t o = 0; o < Orientation::Number; ++o)
+                    for (int x = -WallWidth; x < G::Width; ++x)
+                        for (int y = -5; y < G::Height; ++y)
+                            n += w.Accomodates(BlockType(b),
+                                               Vertex(Dot{x, y}, o));
+        sink = n;
+    });
+    Measure("BlockPosition::MoveIfPossible", positions * 5, [&] {
+        long n = 0;
+        for (const auto & w : midgame)
+            for (size_t b = 0; b < nBlockTypes; ++b)
+                for (size_t o = 0; o < Orientation::Number; ++o)
+                    for (int x = -WallWidth; x < G::Width; ++x)
+                        for (int y = -5; y < G::Height; ++y)
+                            for (int m = 0; m < 5; ++m) {
+                                Vertex v(Dot{x, y}, o);
+                                n += v.MoveIfPossible(Movement(m),
+                                                      BlockType(b), &w);
+                            }
+        sink = n;
+    });
+
+    // the first level of the search, for each block
+    for (size_t b = 0; b < nBlockTypes; ++b) {
+        const string name = string("Searcher/") + GetChar(BlockType(b));
+        Measure(name, all.size(), [&] {
+            size_t n = 0;
+            for (auto & w : all) {
+                CountingVisitor v;
+                Searcher<G>(BlockType(b), &w, start, &v);
+                n += v.GetCount();
+            }
+            sink = n;
+        });
+    }
+
+    // what happens at each landing
+    const vector<Landing> landings = Landings(midgame);
+    vector<Well<G>>       reached;
+    for (const auto & l : landings) {
+        Well<G> w(*l.well);
+        if (w.TryLockAndClearLines(l.block, l.v) != Well<G>::LockedOut)
+            reached.push_back(w);
+    }
+    Measure("Well::LockAndClearLines (with a copy)", reached.size(), [&] {
+        long n = 0;
+        for (const auto & l : landings) {
+            if (l.v.IsOutOfScreen(l.block)) continue;  // would throw
+            Well<G> w(*l.well);
+            n += w.LockAndClearLines(l.block, l.v);
+        }
+        sink = n;
+    });
+    Measure("Well::TryLockAndClearLines + Undo", reached.size(), [&] {
+        long n = 0;
+        for (const auto & l : landings) {
+            WellUndo<G> undo;
+            const int   lines
+                = l.well->TryLockAndClearLines(l.block, l.v, undo);
+            if (lines == Well<G>::LockedOut) continue;
+            l.well->Undo(undo);
+            n += lines;
+        }
+        sink = n;
+    });
+    Measure("Evaluate", reached.size(), [&] {
+        long n = 0;
+        for (const auto & w : reached) n += Evaluate(&w, 1);
+        sink = n;
+    });
+
+    // the two levels of the search, with a fresh table at each call so that
+    // all the repetitions do the same work
+    const struct {
+        const char *            name;
+        const vector<Well<G>> * wells;
+        SearchMode              mode;
+    } sets[] = {{"empty", &empty, SearchMode::Exact},
+                {"midgame", &midgame, SearchMode::Exact},
+                {"near-death", &nearDeath, SearchMode::Exact},
+                {"midgame, hard drops", &midgame, SearchMode::HardDrop},
+                {"near-death, hard drops", &nearDeath, SearchMode::HardDrop}};
+    for (const auto & set : sets) {
+        const string name
+            = string("BastetBlockChooser::ComputeMainScores/") + set.name;
+        Measure(name, set.wells->size() * nBlockTypes, [&] {
+            BastetBlockChooser<G> bc(1, tableBits, set.mode);
+            long                  n = 0;
+            for (const auto & w : *set.wells)
+                for (size_t b = 0; b < nBlockTypes; ++b)
+                    n += bc.ComputeMainScores(&w, BlockType(b))[0];
+            sink = n;
+        }, 3);
+    }
+
+    // the two levels of the search as they were with exceptions, on the
+    // near-death wells where they matter most
+    for (auto & w : nearDeath) {
+        for (size_t b = 0; b < nBlockTypes; ++b) {
+            RecursiveVisitor<G>      v1;
+            ThrowingRecursiveVisitor v2;
+            Searcher<G>(BlockType(b), &w, start, &v1);
+            Searcher<G>(BlockType(b), &w, start, &v2);
+            if (v1.GetScores() != v2.GetScores()) {
+                fprintf(stderr, "scores differ!\n");
+                return 1;
+            }
+        }
+    }
+    Measure("RecursiveVisitor/near-death, game over by exception",
+            nearDeath.size() * nBlockTypes, [&] {
+                for (auto & w : nearDeath)
+                    for (size_t b = 0; b < nBlockTypes; ++b) {
+                        ThrowingRecursiveVisitor v;
+                        Searcher<G>(BlockType(b), &w, start, &v);
+                        sink = v.GetScores()[0];
+                    }
+            }, 3);
+    Measure("RecursiveVisitor/near-death", nearDeath.size() * nBlockTypes,
+            [&] {
+                for (auto & w : nearDeath)
+                    for (size_t b = 0; b < nBlockTypes; ++b) {
+                        RecursiveVisitor<G> v;
+                        Searcher<G>(BlockType(b), &w, start, &v);
+                        sink = v.GetScores()[0];
+                    }
+            }, 3);
+
+    // each duplicate skipped at the first level saves a whole second level
+    size_t distinct = 0, duplicates = 0;
+    for (auto & w : nearDeath)
+        for (size_t b = 0; b < nBlockTypes; ++b) {
+            CountingVisitor v;
+            Searcher<G>     searcher(BlockType(b), &w, start, &v);
+            distinct += searcher.GetLandings();
+            duplicates += searcher.GetDuplicates();
+        }
+    counters.push_back(make_pair("near-death landings", distinct));
+    counters.push_back(make_pair("near-death duplicate landings", duplicates));
+
+    // how often the block the chooser likes best (the one with the least
+    // score) changes with the approximate hard-drop search
+    BastetBlockChooser<G> exact(1, tableBits, SearchMode::Exact);
+    BastetBlockChooser<G> hardDrop(1, tableBits, SearchMode::HardDrop);
+    size_t                differ = 0;
+    for (const auto & w : all)
+        for (size_t b = 0; b < nBlockTypes; ++b) {
+            const auto s1 = exact.ComputeMainScores(&w, BlockType(b));
+            const auto s2 = hardDrop.ComputeMainScores(&w, BlockType(b));
+            if (min_element(s1.begin(), s1.end()) - s1.begin()
+                != min_element(s2.begin(), s2.end()) - s2.begin())
+                ++differ;
+        }
+    counters.push_back(make_pair("choices", all.size() * nBlockTypes));
+    counters.push_back(make_pair("choices differing with hard drops", differ));
+    AddTableCounters("exact chooser", exact.GetTableStats());
+
+    // the deep search must not depend on what its table holds: one chooser
+    // keeps its table over all the wells, the other one has none
+    DeepBlockChooser<G>             warm(chrono::hours(1), 3, 1, tableBits);
+    DeepBlockChooser<G>             none(chrono::hours(1), 3, 1, 0);
+    const auto                      deadline = Clock::now() + chrono::hours(1);
+    RecursiveVisitor<G>::ScoresList s1, s2;
+    for (const auto & w : all)
+        for (size_t b = 0; b < nBlockTypes; ++b) {
+            warm.ComputeDeepScores(&w, BlockType(b), 3, deadline, s1);
+            none.ComputeDeepScores(&w, BlockType(b), 3, deadline, s2);
+            if (s1 != s2) {
+                fprintf(stderr, "deep scores differ with the table!\n");
+                return 1;
+            }
+        }
+    AddTableCounters("deep chooser", warm.GetTableStats());
+
+    if (json)
+        PrintJson();
+    else
+        PrintText();
+}
@@ -18,15 +18,50 @@
 
 #include "Block.hpp"
 
-#include "curses.h"
+#include <algorithm>
 
 namespace Bastet {
 
+    BlockImpl::BlockImpl(const OrientationMatrix & m) : _matrix(m) {
+        for (size_t o = 0; o < Orientation::Number; ++o) {
+            BlockShape & s = _shapes[o];
+            s.min = s.max = m[o][0];
+            s.bottom.fill(-1);
+            s.top.fill(4);
+            s.lines.fill(0);
+            for (const Dot & d : m[o]) {
+                s.min.x       = std::min(s.min.x, d.x);
+                s.min.y       = std::min(s.min.y, d.y);
+                s.max.x       = std::max(s.max.x, d.x);
+                s.max.y       = std::max(s.max.y, d.y);
+                s.bottom[d.x] = std::max(s.bottom[d.x], d.y);
+                s.top[d.x]    = std::min(s.top[d.x], d.y);
+                s.lines[d.y] |= 1u << d.x;
+            }
+        }
+        // the same dots give the same lines once moved to the same corner
+        for (size_t o = 0; o < Orientation::Number; ++o) {
+            BlockShape & s = _shapes[o];
+            for (size_t c = 0; c <= o; ++c) {
+                const BlockShape & t = _shapes[c];
+                if (s.max.y - s.min.y == t.max.y - t.min.y
+                    && std::equal(s.lines.begin() + s.min.y,
+                                  s.lines.begin() + s.max.y + 1,
+                                  t.lines.begin() + t.min.y,
+                                  [&](unsigned a, unsigned b) {
+                                      return a >> s.min.x == b >> t.min.x;
+                                  })) {
+                    s.canonical = c;
+                    s.offset    = (Dot){s.min.x - t.min.x, s.min.y - t.min.y};
+                    break;
+                }
+            }
+        }
+    }
+
     BlockArray blocks{
-        {BlockImpl(COLOR_PAIR(7),
-                   (OrientationMatrix){
-                       {// O //should be yellow, but I find no portable way to
-                        // output a yellow solid block character in ncurses.
+        {BlockImpl((OrientationMatrix){
+                       {// O
                         {{// orientation 0 (initial
                           {1, 1},
                           {2, 1},
@@ -47,8 +82,7 @@ namespace Bastet {
                           {2, 1},
                           {1, 0},
                           {2, 0}}}}}),
-         BlockImpl(COLOR_PAIR(4),
-                   (OrientationMatrix){{  // I
+         BlockImpl((OrientationMatrix){{  // I
                                         {{// orientation 0 (initial)
                                           {0, 1},
                                           {1, 1},
@@ -69,8 +103,7 @@ namespace Bastet {
                                           {1, 1},
                                           {1, 2},
                                           {1, 0}}}}}),
-         BlockImpl(COLOR_PAIR(1),
-                   (OrientationMatrix){{  // Z
+         BlockImpl((OrientationMatrix){{  // Z
                                         {{// orientation 0 (initial
                                           {1, 1},
                                           {2, 1},
@@ -91,8 +124,7 @@ namespace Bastet {
                                           {0, 1},
                                           {1, 1},
                                           {1, 0}}}}}),
-         BlockImpl(COLOR_PAIR(5),
-                   (OrientationMatrix){{  // T
+         BlockImpl((OrientationMatrix){{  // T
                                         {{// orientation 0 (initial
                                           {0, 1},
                                           {1, 1},
@@ -113,8 +145,7 @@ namespace Bastet {
                                           {0, 1},
                                           {1, 1},
                                           {1, 0}}}}}),
-         BlockImpl(COLOR_PAIR(6),
-                   (OrientationMatrix){{  // J
+         BlockImpl((OrientationMatrix){{  // J
                                         {{// orientation 0 (initial
                                           {0, 1},
                                           {1, 1},
@@ -135,8 +166,7 @@ namespace Bastet {
                                           {1, 2},
                                           {1, 1},
                                           {1, 0}}}}}),
-         BlockImpl(COLOR_PAIR(3),
-                   (OrientationMatrix){{  // S
+         BlockImpl((OrientationMatrix){{  // S
                                         {{// orientation 0 (initial
                                           {0, 1},
                                           {1, 1},
@@ -157,8 +187,7 @@ namespace Bastet {
                                           {0, 1},
                                           {1, 1},
                                           {0, 0}}}}}),
-         BlockImpl(COLOR_PAIR(2),
-                   (OrientationMatrix){{  // L
+         BlockImpl((OrientationMatrix){{  // L
                                         {{// orientation 0 (initial
                                           {0, 1},
                                           {1, 1},
@@ -180,9 +209,5 @@ namespace Bastet {
                                           {0, 0},
                                           {1, 0}}}}})}};
 
-    Color GetColor(BlockType b) { return blocks[b].GetColor(); }
-
     char GetChar(BlockType b) { return "OIZTJSL"[int(b)]; }
-
-    size_t hash_value(const Dot & d) { return (d.x + 5) * 32 + d.y; }
 }  // namespace Bastet
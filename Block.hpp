@@ -19,18 +19,81 @@
 #ifndef BLOCK_HPP
 #define BLOCK_HPP
 
-#include <curses.h>
-
 #include <array>
+#include <cstddef>  //size_t
+#include <cstdint>
 
 namespace Bastet {
 
-    static constexpr int WellHeight     = 20;
-    static constexpr int WellWidth      = 10;
-    static constexpr int RealWellHeight = WellHeight + 2;
+    /// columns of wall on each side of a packed well line, see BasicGeometry
+    static constexpr int WallWidth = 3;
+
+    /**
+     * the constants of a well W columns wide, with H visible lines and two
+     * hidden ones above them, whose lines are packed in an L: dot x lives in
+     * bit x+WallWidth. The bits outside the playfield are always set, so that
+     * they act as walls and a tetromino sticking out of the well collides with
+     * them. The engine is templated on the geometry, so all of these are
+     * compile-time constants, and so are the loops over them
+     */
+    template<int W, int H, typename L>
+    struct BasicGeometry {
+        static constexpr int Width      = W;
+        static constexpr int Height     = H;
+        static constexpr int RealHeight = H + 2;
+        static constexpr int StartX     = (W - 4) / 2;  // where blocks appear
+
+        using Line = L;
+        static constexpr int  LineBits  = 8 * sizeof(Line);
+        static constexpr Line LineMask  = Line(((1u << W) - 1) << WallWidth);
+        static constexpr Line EmptyLine = Line(~LineMask);
+        static constexpr Line FullLine  = Line(~0u);
+        static_assert(W + 2 * WallWidth <= LineBits,
+                      "the well does not fit into a Line");
+
+        /// the bit of a Line that holds dot x (x may be inside the walls)
+        static Line DotMask(int x) { return Line(1u << (x + WallWidth)); }
+    };
 
-    // to be given to wattrset
-    using Color = int;
+    template<int W, int H, typename L>
+    constexpr int BasicGeometry<W, H, L>::Width;
+    template<int W, int H, typename L>
+    constexpr int BasicGeometry<W, H, L>::Height;
+    template<int W, int H, typename L>
+    constexpr int BasicGeometry<W, H, L>::RealHeight;
+    template<int W, int H, typename L>
+    constexpr int BasicGeometry<W, H, L>::StartX;
+    template<int W, int H, typename L>
+    constexpr int BasicGeometry<W, H, L>::LineBits;
+    template<int W, int H, typename L>
+    constexpr L BasicGeometry<W, H, L>::LineMask;
+    template<int W, int H, typename L>
+    constexpr L BasicGeometry<W, H, L>::EmptyLine;
+    template<int W, int H, typename L>
+    constexpr L BasicGeometry<W, H, L>::FullLine;
+
+    /// the geometries the engine is built for, with the smallest Line which
+    /// holds their columns and walls. Only the specializations exist
+    template<int Width, int Height>
+    struct WellGeometry;
+
+    template<>
+    struct WellGeometry<10, 20> : BasicGeometry<10, 20, uint16_t> {};
+
+    template<>
+    struct WellGeometry<16, 20> : BasicGeometry<16, 20, uint32_t> {};
+
+    template<>
+    struct WellGeometry<10, 30> : BasicGeometry<10, 30, uint16_t> {};
+
+    using StandardGeometry = WellGeometry<10, 20>;
+    using WideGeometry     = WellGeometry<16, 20>;
+    using TallGeometry     = WellGeometry<10, 30>;
+
+/// expands X(G) for each geometry above: the templates of the engine are
+/// defined in their .cpp files, and instantiated there for these only
+#define BASTET_GEOMETRIES(X) \
+    X(StandardGeometry) X(WideGeometry) X(TallGeometry)
 
     class Orientation {
        public:
@@ -71,8 +134,10 @@ namespace Bastet {
         int x;
         int y;
 
+        /// inside a well of geometry G, hidden lines included
+        template<typename G>
         bool IsValid() const {
-            return (y >= -2) && y < WellHeight && (x >= 0) && (x < WellWidth);
+            return (y >= -2) && y < G::Height && (x >= 0) && (x < G::Width);
         }
 
         Dot operator+(const Dot & d) const { return (Dot){x + d.x, y + d.y}; }
@@ -99,26 +164,44 @@ namespace Bastet {
                 return x < other.x;
             }
         }
+    };
 
-        // for use with boost::hash and unordered_set
-        friend size_t hash_value(const Dot & d);
+    /**
+     * the shape of a tetromino in a given orientation, precomputed in the
+     * layout of the well lines so that collisions and locking are a few
+     * mask operations. All coordinates are relative to the block position.
+     */
+    struct BlockShape {
+        Dot min;  // bounding box of the four dots
+        Dot max;
+        /// lowest dy occupied in each of the 4 columns, -1 if there is none
+        std::array<int, 4> bottom;
+        /// highest dy occupied in each of the 4 columns, 4 if there is none
+        std::array<int, 4> top;
+        /// bit dx of lines[dy] is set for each dot (dx,dy): when the block
+        /// lies at (x,y), the dots on line y+dy are lines[dy] << (x+WallWidth)
+        std::array<unsigned, 4> lines;
+        /// the first orientation whose dots are the same as these up to a
+        /// translation: the block at (x,y) covers the same dots as the block
+        /// in orientation canonical at (x,y)+offset
+        Orientation canonical;
+        Dot         offset;
     };
 
     class BlockImpl {
        private:
-        const OrientationMatrix _matrix;
-        const Color             _color;
+        const OrientationMatrix                      _matrix;
+        std::array<BlockShape, Orientation::Number> _shapes;
 
        public:
-        BlockImpl(Color c, const OrientationMatrix & m)
-            : _matrix(m), _color(c){};
+        explicit BlockImpl(const OrientationMatrix & m);
 
         /**
          * returns an array of 4 (x,y) pair for the occupied dots
          */
         const OrientationMatrix & GetOrientationMatrix() { return _matrix; }
 
-        Color GetColor() const { return _color; };
+        const BlockShape & GetShape(Orientation o) const { return _shapes[o]; }
     };
 
     using BlockArray = std::array<BlockImpl, 7>;
@@ -126,7 +209,6 @@ namespace Bastet {
 
     // should be members, but BlockType is an enum...
     //  DotMatrix GetDots(BlockType b, Dot position, Orientation o);
-    Color GetColor(BlockType b);
 
     char GetChar(BlockType b);
 
@@ -18,20 +18,24 @@
 
 #include "BlockChooser.hpp"
 
-#include <cstdlib>  //random
-
 namespace Bastet {
 
-    Queue RandomBlockChooser::GetStartingQueue() {
+    template<typename G>
+    Queue RandomBlockChooser<G>::GetStartingQueue() {
         Queue q;
-        q.push(BlockType(random() % nBlockTypes));
-        q.push(BlockType(random() % nBlockTypes));
+        q.push(BlockType(this->_random.Below(nBlockTypes)));
+        q.push(BlockType(this->_random.Below(nBlockTypes)));
         return q;
     }
 
-    BlockType RandomBlockChooser::GetNext(const Well * /*well*/,
-                                          const Queue & /*q*/) {
-        return BlockType(random() % nBlockTypes);
+    template<typename G>
+    BlockType RandomBlockChooser<G>::GetNext(const Well<G> * /*well*/,
+                                             const Queue & /*q*/) {
+        return BlockType(this->_random.Below(nBlockTypes));
     }
 
+#define INSTANTIATE(G) template class RandomBlockChooser<G>;
+    BASTET_GEOMETRIES(INSTANTIATE)
+#undef INSTANTIATE
+
 }  // namespace Bastet
@@ -19,32 +19,57 @@
 #ifndef BLOCKCHOOSER_HPP
 #define BLOCKCHOOSER_HPP
 
+#include <cstdint>
 #include <queue>
 
 #include "Block.hpp"
+#include "Random.hpp"
 
 namespace Bastet {
 
+    template<typename G>
     class Well;
     // queue of blocks to appear on the screen
     using Queue = std::queue<BlockType>;
 
-    /// Abstract class to represent a block choosing algorithm
+    /// Abstract class to represent a block choosing algorithm, for the wells
+    /// of geometry G
+    template<typename G>
     class BlockChooser {
        public:
+        /// all the random choices come from seed: the same seed and the same
+        /// moves of the player give the same blocks
+        explicit BlockChooser(uint64_t seed = NewSeed())
+            : _random(seed), _seed(seed) {}
         virtual ~BlockChooser() = default;
         // chooses first blocks after a game starts
         virtual Queue GetStartingQueue() = 0;
         // chooses next block
-        virtual BlockType GetNext(const Well * well, const Queue & q) = 0;
+        virtual BlockType GetNext(const Well<G> * well, const Queue & q) = 0;
+        // hint that GetNext(well, q) is likely to be called soon: a chooser
+        // may start working on it in the background. Asynchronous choosers
+        // must finish or cancel that work before GetNext returns.
+        virtual void Speculate(const Well<G> * /*well*/, const Queue & /*q*/) {
+        }
+
+        uint64_t GetSeed() const { return _seed; }
+
+       protected:
+        Pcg32 _random;
+
+       private:
+        uint64_t _seed;
     };
 
     /// the usual Tetris random block chooser, for testing purposes
-    class RandomBlockChooser : public BlockChooser {
+    template<typename G>
+    class RandomBlockChooser : public BlockChooser<G> {
        public:
+        explicit RandomBlockChooser(uint64_t seed = NewSeed())
+            : BlockChooser<G>(seed) {}
         virtual ~RandomBlockChooser() = default;
         virtual Queue     GetStartingQueue();
-        virtual BlockType GetNext(const Well * well, const Queue & q);
+        virtual BlockType GetNext(const Well<G> * well, const Queue & q);
     };
 
 }  // namespace Bastet
@@ -18,8 +18,6 @@
 
 #include "BlockPosition.hpp"
 
-#include <algorithm>
-
 #include "Block.hpp"
 #include "Well.hpp"
 
@@ -48,8 +46,9 @@ namespace Bastet {
         }
     }
 
+    template<typename G>
     bool BlockPosition::MoveIfPossible(Movement m, BlockType b,
-                                       const Well * w) {
+                                       const Well<G> * w) {
         auto p = *this;
         p.Move(m);
         if (p.IsValid(b, w)) {
@@ -59,18 +58,26 @@ namespace Bastet {
             return false;
     }
 
-    bool BlockPosition::IsValid(BlockType bt, const Well * w) const {
-        return w->Accomodates(GetDots(bt));  // XX: must change, unoptimized
+    template<typename G>
+    bool BlockPosition::IsValid(BlockType bt, const Well<G> * w) const {
+        return w->Accomodates(bt, *this);
     }
 
-    void BlockPosition::Drop(BlockType bt, const Well * w) {
+    template<typename G>
+    void BlockPosition::Drop(BlockType bt, const Well<G> * w) {
         while (MoveIfPossible(Down, bt, w)) {}
     }
 
     bool BlockPosition::IsOutOfScreen(BlockType bt) const {
-        const auto dots = GetDots(bt);
-        return std::none_of(dots.begin(), dots.end(),
-                            [](const Dot & d) { return d.y >= 0; });
+        return _pos.y + GetShape(bt).max.y < 0;
     }
 
+#define INSTANTIATE(G)                                                         \
+    template bool BlockPosition::MoveIfPossible(Movement, BlockType,           \
+                                                const Well<G> *);              \
+    template void BlockPosition::Drop(BlockType, const Well<G> *);             \
+    template bool BlockPosition::IsValid(BlockType, const Well<G> *) const;
+    BASTET_GEOMETRIES(INSTANTIATE)
+#undef INSTANTIATE
+
 }  // namespace Bastet
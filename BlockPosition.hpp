@@ -26,6 +26,7 @@ namespace Bastet {
     /** Block position = position (x,y) + orientation -- this is the object that
      * gets evaluated by the block chooser
      */
+    template<typename G>
     class Well;
 
     enum Movement { RotateCW, RotateCCW, Left, Right, Down };
@@ -38,23 +39,34 @@ namespace Bastet {
        public:
         BlockPosition(Dot d = Dot{3, -2}, Orientation o = Orientation{})
             : _pos(d), _orientation(o){};
+        /// where the blocks appear in a well of geometry G
+        template<typename G>
+        static BlockPosition Start() {
+            return BlockPosition(Dot{G::StartX, -2});
+        }
         bool operator==(const BlockPosition & p) const {
             return _pos == p._pos && _orientation == p._orientation;
         }
         /// returns an y such that the block lies completely in [y,y+3]
-        int  GetBaseY() const { return _pos.y; }
+        int         GetBaseY() const { return _pos.y; }
+        const Dot & GetPos() const { return _pos; }
+        Orientation GetOrientation() const { return _orientation; }
+        /// the precomputed masks of block b in the current orientation
+        const BlockShape & GetShape(BlockType b) const {
+            return blocks[b].GetShape(_orientation);
+        }
+
         void Move(Movement m);
-        bool MoveIfPossible(Movement m, BlockType b, const Well * w);
+        template<typename G>
+        bool MoveIfPossible(Movement m, BlockType b, const Well<G> * w);
 
-        void Drop(BlockType bt, const Well * w);
+        template<typename G>
+        void Drop(BlockType bt, const Well<G> * w);
 
         const DotMatrix GetDots(BlockType b) const;
-        bool            IsValid(BlockType bt, const Well * w) const;
-        bool            IsOutOfScreen(BlockType bt) const;
-
-        friend size_t hash_value(const BlockPosition & p) {
-            return hash_value(p._pos) * 4 + int(p._orientation);
-        }
+        template<typename G>
+        bool IsValid(BlockType bt, const Well<G> * w) const;
+        bool IsOutOfScreen(BlockType bt) const;
     };
 
 }  // namespace Bastet
@@ -0,0 +1,228 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// bastet_book: builds the opening book of BastetBlockChooser, from all the
+// wells reachable in the first few blocks and from the wells of sampled
+// games, as long as they stay low.
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "BastetBlockChooser.hpp"
+#include "OpeningBook.hpp"
+#include "Random.hpp"
+#include "Well.hpp"
+
+using namespace Bastet;
+using namespace std;
+
+namespace po = boost::program_options;
+
+namespace {
+
+    // the wells to put into the book, each once
+    template<typename G>
+    class WellSet {
+       public:
+        explicit WellSet(int maxHeight) : _maxHeight(maxHeight) {}
+        bool Add(const Well<G> & w) {
+            if (w.GetMaxHeight() > _maxHeight) return false;
+            if (!_hashes.insert(w.GetHash()).second) return false;
+            _wells.push_back(w);
+            return true;
+        }
+        const vector<Well<G>> & GetWells() const { return _wells; }
+
+       private:
+        int                     _maxHeight;
+        unordered_set<uint64_t> _hashes;
+        vector<Well<G>>         _wells;
+    };
+
+    // the wells left by b at each of its landings in w
+    template<typename G>
+    vector<Well<G>> Children(Well<G> w, BlockType b, SearchMode mode) {
+        vector<Well<G>>     children;
+        const BlockPosition start = BlockPosition::Start<G>();
+        if (!start.IsValid(b, &w)) return children;
+        LandingsVisitor<G> v;
+        Searcher<G>(b, &w, start, &v, mode);
+        for (const Vertex & l : v.GetLandings()) {
+            Well<G> child(w);
+            if (child.TryLockAndClearLines(b, l) != Well<G>::LockedOut)
+                children.push_back(child);
+        }
+        return children;
+    }
+
+    // every well that depth blocks can leave, starting from the empty one
+    template<typename G>
+    void Enumerate(int depth, SearchMode mode, WellSet<G> & wells) {
+        vector<Well<G>> level(1);
+        for (int d = 0; d < depth; ++d) {
+            vector<Well<G>> next;
+            for (const auto & w : level)
+                for (size_t b = 0; b < nBlockTypes; ++b)
+                    for (const auto & child : Children(w, BlockType(b), mode))
+                        if (wells.Add(child)) next.push_back(child);
+            level.swap(next);
+        }
+    }
+
+    // the wells of games where a player drops each block where it leaves
+    // the lowest well (the first such landing in a random order)
+    template<typename G>
+    void Sample(int games, int pieces, uint64_t seed, SearchMode mode,
+                WellSet<G> & wells) {
+        Pcg32 random(seed);
+        for (int g = 0; g < games; ++g) {
+            Well<G> w;
+            for (int p = 0; p < pieces; ++p) {
+                const BlockType b = BlockType(random.Below(nBlockTypes));
+                auto            children = Children(w, b, mode);
+                if (children.empty()) break;
+                shuffle(children.begin(), children.end(), random);
+                w = *min_element(children.begin(), children.end(),
+                                 [](const Well<G> & a, const Well<G> & b) {
+                                     return a.GetMaxHeight() < b.GetMaxHeight();
+                                 });
+                wells.Add(w);
+            }
+        }
+    }
+
+    // the book entries of the wells, scored by a chooser of the given search
+    template<typename G>
+    vector<OpeningBook::Entry> Build(int depth, int maxHeight, int games,
+                                     int pieces, uint64_t seed,
+                                     SearchMode mode, int threads,
+                                     unsigned tableBits) {
+        WellSet<G> wells(maxHeight);
+        Enumerate(depth, mode, wells);
+        Sample(games, pieces, seed, mode, wells);
+        fprintf(stderr, "%zu wells\n", wells.GetWells().size());
+
+        BastetBlockChooser<G>      bc(max(threads, 1), tableBits, mode);
+        vector<OpeningBook::Entry> entries;
+        for (const auto & w : wells.GetWells()) {
+            for (size_t b = 0; b < nBlockTypes; ++b) {
+                const auto scores = bc.ComputeMainScores(&w, BlockType(b));
+                OpeningBook::Entry e;
+                e.hash   = w.GetHash();
+                e.block  = b;
+                e.unused = 0;
+                copy(scores.begin(), scores.end(), e.scores);
+                entries.push_back(e);
+            }
+            if (entries.size() % 7000 == 0)
+                fprintf(stderr, "%zu/%zu\n", entries.size() / nBlockTypes,
+                        wells.GetWells().size());
+        }
+        return entries;
+    }
+
+}  // namespace
+
+int main(int argc, char ** argv) {
+    string   output, mode, geometry;
+    int      depth, maxHeight, games, pieces, threads;
+    unsigned tableBits;
+    uint64_t seed;
+
+    po::options_description opts("Options");
+    opts.add_options()("help,h", "show this help")(
+        "output,o", po::value<string>(&output)->default_value("bastet.book"),
+        "book to write")(
+        "depth,d", po::value<int>(&depth)->default_value(2),
+        "add all the wells left by the first blocks")(
+        "max-height", po::value<int>(&maxHeight)->default_value(6),
+        "leave out the wells higher than this")(
+        "games,n", po::value<int>(&games)->default_value(0),
+        "add the wells of this many sampled games")(
+        "pieces,p", po::value<int>(&pieces)->default_value(12),
+        "blocks of each sampled game")(
+        "seed", po::value<uint64_t>(&seed)->default_value(1),
+        "seed of the sampled games")(
+        "mode,m", po::value<string>(&mode)->default_value("exact"),
+        "search of the chooser using the book: exact or harddrop")(
+        "geometry,g", po::value<string>(&geometry)->default_value("10x20"),
+        "well, width x height: 10x20, 16x20 or 10x30")(
+        "threads,j",
+        po::value<int>(&threads)->default_value(
+            max(1u, thread::hardware_concurrency())),
+        "threads of the search")(
+        "table-bits",
+        po::value<unsigned>(&tableBits)
+            ->default_value(TranspositionTable::DefaultLog2Size),
+        "the table of each thread holds 2^bits entries");
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, opts), vm);
+        po::notify(vm);
+    } catch (const po::error & e) {
+        cerr << e.what() << "\n" << opts;
+        return 2;
+    }
+    if (vm.count("help")) {
+        cout << opts;
+        return 0;
+    }
+    SearchMode searchMode;
+    if (mode == "exact")
+        searchMode = SearchMode::Exact;
+    else if (mode == "harddrop")
+        searchMode = SearchMode::HardDrop;
+    else {
+        cerr << "unknown search mode " << mode << "\n";
+        return 2;
+    }
+    int width, height;
+    if (sscanf(geometry.c_str(), "%dx%d", &width, &height) != 2) {
+        cerr << "unknown geometry " << geometry << "\n";
+        return 2;
+    }
+
+    vector<OpeningBook::Entry> entries;
+    bool                       built = false;
+#define BUILD(G)                                                               \
+    if (!built && width == G::Width && height == G::Height) {                  \
+        entries = Build<G>(depth, maxHeight, games, pieces, seed, searchMode,  \
+                           threads, tableBits);                                \
+        built   = true;                                                        \
+    }
+    BASTET_GEOMETRIES(BUILD)
+#undef BUILD
+    if (!built) {
+        cerr << "unknown geometry " << geometry << "\n";
+        return 2;
+    }
+    if (!OpeningBook::Write(output, entries, searchMode, width, height)) {
+        cerr << "cannot write " << output << "\n";
+        return 1;
+    }
+    fprintf(stderr, "%zu entries written to %s\n", entries.size(),
+            output.c_str());
+}
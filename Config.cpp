@@ -39,6 +39,9 @@ namespace Bastet {
     const std::string RcFileName               = "/.bastetrc";
     const std::string LocalHighScoresFileName  = "/.bastetscores";
     const std::string GlobalHighScoresFileName = "/var/games/bastet.scores2";
+    const std::string LatencyFileName          = "/.bastetlatency";
+    const std::string ReplayFileName           = "/.bastetreplay";
+    const std::string OpeningBookFileName      = "/.bastetbook";
 
     bool HighScores::Qualifies(int score) {
         stable_sort(begin(), end());
@@ -62,6 +65,18 @@ namespace Bastet {
         return string(getenv("HOME")) + RcFileName;
     }
 
+    std::string Config::GetLatencyFileName() const {
+        return string(getenv("HOME")) + LatencyFileName;
+    }
+
+    std::string Config::GetReplayFileName() const {
+        return string(getenv("HOME")) + ReplayFileName;
+    }
+
+    std::string Config::GetOpeningBookFileName() const {
+        return string(getenv("HOME")) + OpeningBookFileName;
+    }
+
     class CannotOpenFile final {};
 
     std::string Config::GetHighScoresFileName() const {
@@ -118,6 +133,11 @@ namespace Bastet {
             "Drop tetromino key")("Pause", po::value<int>()->default_value('p'),
                                   "Pause key");
 
+        po::options_description chooserOpts("Block chooser");
+        chooserOpts.add_options()(
+            "SearchBudget", po::value<int>()->default_value(30),
+            "Time the deep block chooser may search for each block (ms)");
+
         po::options_description highScoresOpts("High scores");
         boost::format           scorer("Scorer%02d%02d");
         boost::format           score("Score%02d%02d");
@@ -134,8 +154,10 @@ namespace Bastet {
         boost::program_options::variables_map _options;
         boost::program_options::variables_map _highScores;
 
+        po::options_description rcOpts;
+        rcOpts.add(keyMappingOpts).add(chooserOpts);
         ifstream ifs{GetConfigFileName().c_str()};
-        po::store(po::parse_config_file(ifs, keyMappingOpts), _options);
+        po::store(po::parse_config_file(ifs, rcOpts), _options);
 
         _keys.Down      = _options["Down"].as<int>();
         _keys.Left      = _options["Left"].as<int>();
@@ -144,6 +166,7 @@ namespace Bastet {
         _keys.RotateCCW = _options["RotateCCW"].as<int>();
         _keys.Drop      = _options["Drop"].as<int>();
         _keys.Pause     = _options["Pause"].as<int>();
+        _searchBudget   = _options["SearchBudget"].as<int>();
 
         auto     s = GetHighScoresFileName();
         ifstream ifs2{s.c_str()};
@@ -187,6 +210,8 @@ namespace Bastet {
             make_pair("Drop", po::variable_value(_keys.Drop, false)));
         _options.insert(
             make_pair("Pause", po::variable_value(_keys.Pause, false)));
+        _options.insert(make_pair(
+            "SearchBudget", po::variable_value(_searchBudget, false)));
 
         ofstream ofs(GetConfigFileName().c_str());
         ofs << "# Automatically regenerated by the program at each run, edit "
@@ -210,5 +235,14 @@ namespace Bastet {
                 i++;
             }
         }
+
+        // merged at the last moment, in case another bastet has written the
+        // file in the meantime
+        if (_latencies.GetCount()) {
+            LatencyHistogram all;
+            all.Load(GetLatencyFileName());
+            all += _latencies;
+            all.Save(GetLatencyFileName());
+        }
     }
 }  // namespace Bastet
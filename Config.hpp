@@ -23,6 +23,8 @@
 #include <string>
 #include <vector>
 
+#include "LatencyHistogram.hpp"
+
 namespace Bastet {
 
     struct Keys {
@@ -50,7 +52,9 @@ namespace Bastet {
     enum difficulty_t {
         difficulty_normal = 0,
         difficulty_hard   = 1,
-        num_difficulties  = 2
+        difficulty_deep   = 2,
+        difficulty_wide   = 3,
+        num_difficulties  = 4
     };
 
     // a set would not do the right job
@@ -66,19 +70,34 @@ namespace Bastet {
     extern const std::string RcFileName;
     extern const std::string LocalHighScoresFileName;
     extern const std::string GlobalHighScoresFileName;
+    extern const std::string LatencyFileName;
+    extern const std::string ReplayFileName;
+    extern const std::string OpeningBookFileName;
 
     class Config {
        private:
         Keys                                     _keys;
         std::array<HighScores, num_difficulties> _hs;
+        int                                      _searchBudget;  // in ms
+        LatencyHistogram                         _latencies;  // this session
 
        public:
         Config();
         ~Config();
-        Keys *       GetKeys();
-        HighScores * GetHighScores(int difficulty);
-        std::string  GetConfigFileName() const;
-        std::string  GetHighScoresFileName() const;
+        Keys *             GetKeys();
+        HighScores *       GetHighScores(int difficulty);
+        /// how long the deep block chooser may search for each block, in ms
+        int                GetSearchBudget() const { return _searchBudget; }
+        std::string        GetConfigFileName() const;
+        std::string        GetHighScoresFileName() const;
+        /// the GetNext latencies of the previous sessions, to which those of
+        /// this session (GetLatencies()) are added at exit
+        std::string        GetLatencyFileName() const;
+        LatencyHistogram * GetLatencies() { return &_latencies; }
+        /// the replay of the last game played
+        std::string        GetReplayFileName() const;
+        /// precomputed choices for the first blocks (see bastet_book)
+        std::string        GetOpeningBookFileName() const;
     };
 
     extern Config config;  // singleton
@@ -0,0 +1,166 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <boost/format.hpp>
+#include <cstdlib>  //strtoul
+#include <fstream>
+#include <limits>
+
+using namespace std;
+
+namespace Bastet {
+
+    // changes whenever the buckets do, so that old files are not misread
+    static const string Header = "# bastet GetNext latencies, v1";
+
+    LatencyHistogram::LatencyHistogram() {
+        for (auto & band : _counts)
+            for (auto & counts : band) counts.fill(0);
+        _max.fill(0);
+    }
+
+    size_t LatencyHistogram::BucketOf(uint64_t us) {
+        us = min<uint64_t>(us, numeric_limits<uint32_t>::max());
+        if (us < 2 * SubBuckets) return us;
+        // us has k+1 bits: the bucket is given by the top SubBucketBits+1
+        const int k = 63 - __builtin_clzll(us);
+        return (k - SubBucketBits + 1) * SubBuckets
+               + ((us >> (k - SubBucketBits)) - SubBuckets);
+    }
+
+    uint64_t LatencyHistogram::BucketTop(size_t bucket) {
+        if (bucket < 2 * SubBuckets) return bucket;
+        const int      k     = bucket / SubBuckets + SubBucketBits - 1;
+        const uint64_t first = (SubBuckets + bucket % SubBuckets)
+                               << (k - SubBucketBits);
+        return first + (uint64_t(1) << (k - SubBucketBits)) - 1;
+    }
+
+    void LatencyHistogram::Record(std::chrono::nanoseconds latency,
+                                  int height, BlockType b) {
+        const uint64_t us = max<int64_t>(latency.count(), 0) / 1000;
+        const size_t   band
+            = min<size_t>(max(height, 0) / BandHeight, Bands - 1);
+        ++_counts[band][b][BucketOf(us)];
+        _max[band] = max(_max[band], us);
+    }
+
+    LatencyHistogram & LatencyHistogram::operator+=(
+        const LatencyHistogram & h) {
+        for (size_t band = 0; band < Bands; ++band) {
+            for (size_t b = 0; b < nBlockTypes; ++b)
+                for (size_t i = 0; i < Buckets; ++i)
+                    _counts[band][b][i] += h._counts[band][b][i];
+            _max[band] = max(_max[band], h._max[band]);
+        }
+        return *this;
+    }
+
+    uint64_t LatencyHistogram::GetCount() const {
+        uint64_t n = 0;
+        for (size_t band = 0; band < Bands; ++band) n += GetCount(band);
+        return n;
+    }
+
+    uint64_t LatencyHistogram::GetCount(size_t band) const {
+        uint64_t n = 0;
+        for (const auto & counts : _counts[band])
+            for (auto c : counts) n += c;
+        return n;
+    }
+
+    uint64_t LatencyHistogram::GetPercentile(size_t band, double q) const {
+        const uint64_t total = GetCount(band);
+        if (total == 0) return 0;
+        // the rank of the wanted latency, counting from 1
+        const uint64_t rank = max<uint64_t>(1, uint64_t(q * total + 0.5));
+        uint64_t       seen = 0;
+        for (size_t i = 0; i < Buckets; ++i) {
+            for (const auto & counts : _counts[band]) seen += counts[i];
+            if (seen >= rank) return min(BucketTop(i), _max[band]);
+        }
+        return _max[band];
+    }
+
+    // the file has a line "max <band> <us>" for each band, then a line
+    // "<band> <block> <bucket> <count>" for each bucket in use
+    bool LatencyHistogram::Load(const std::string & fileName) {
+        ifstream ifs(fileName.c_str());
+        string   header;
+        if (!getline(ifs, header) || header != Header) return false;
+        LatencyHistogram h;
+        string           word;
+        while (ifs >> word) {
+            size_t band;
+            if (word == "max") {
+                uint64_t us;
+                if (!(ifs >> band >> us) || band >= Bands) return false;
+                h._max[band] = us;
+                continue;
+            }
+            char * end;
+            band = strtoul(word.c_str(), &end, 10);
+            if (*end) return false;
+            size_t   b, bucket;
+            uint64_t count;
+            if (!(ifs >> b >> bucket >> count) || band >= Bands
+                || b >= nBlockTypes || bucket >= Buckets)
+                return false;
+            h._counts[band][b][bucket] = count;
+        }
+        *this += h;
+        return true;
+    }
+
+    bool LatencyHistogram::Save(const std::string & fileName) const {
+        ofstream ofs(fileName.c_str());
+        ofs << Header << '\n';
+        for (size_t band = 0; band < Bands; ++band)
+            ofs << "max " << band << ' ' << _max[band] << '\n';
+        for (size_t band = 0; band < Bands; ++band)
+            for (size_t b = 0; b < nBlockTypes; ++b)
+                for (size_t i = 0; i < Buckets; ++i)
+                    if (_counts[band][b][i])
+                        ofs << band << ' ' << b << ' ' << i << ' '
+                            << _counts[band][b][i] << '\n';
+        return bool(ofs);
+    }
+
+    static string Milliseconds(uint64_t us) {
+        return str(boost::format("%.1f") % (us / 1e3));
+    }
+
+    void LatencyHistogram::PrintReport(std::ostream & os) const {
+        boost::format fmt("%-10s %10s %10s %10s %10s\n");
+        os << fmt % "height" % "blocks" % "p50 ms" % "p99 ms" % "max ms";
+        for (size_t band = 0; band < Bands; ++band) {
+            const int low  = band * BandHeight;
+            const int high = band + 1 < Bands ? low + BandHeight - 1
+                                              : StandardGeometry::RealHeight;
+            os << fmt % str(boost::format("%d-%d") % low % high)
+                      % GetCount(band)
+                      % Milliseconds(GetPercentile(band, .5))
+                      % Milliseconds(GetPercentile(band, .99))
+                      % Milliseconds(GetMax(band));
+        }
+    }
+
+}  // namespace Bastet
@@ -0,0 +1,81 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>  //size_t
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+#include "Block.hpp"
+
+namespace Bastet {
+
+    /**
+     * counts of BlockChooser::GetNext durations, by band of well height and by
+     * the block chosen. As in HDR histograms, each power of two of
+     * microseconds is split in SubBuckets equal buckets, so any latency from
+     * 1us to an hour is kept with a relative error below 1/SubBuckets
+     */
+    class LatencyHistogram {
+       public:
+        static constexpr int    SubBucketBits = 3;
+        static constexpr size_t SubBuckets    = 1 << SubBucketBits;
+        static constexpr size_t Buckets = (33 - SubBucketBits) * SubBuckets;
+        static constexpr int    BandHeight = 5;  // rows of well per band
+        // the wells of the game are all as tall as the standard one; taller
+        // ones would fall into the last band
+        static constexpr size_t Bands
+            = StandardGeometry::RealHeight / BandHeight + 1;
+
+        LatencyHistogram();
+
+        /// height is the one of the well GetNext was asked about
+        void Record(std::chrono::nanoseconds latency, int height, BlockType b);
+        LatencyHistogram & operator+=(const LatencyHistogram & h);
+
+        uint64_t GetCount() const;
+        uint64_t GetCount(size_t band) const;
+        /// the latency in us that a fraction q of those in band do not
+        /// exceed, rounded up to the top of its bucket
+        uint64_t GetPercentile(size_t band, double q) const;
+        uint64_t GetMax(size_t band) const { return _max[band]; }  // exact
+
+        /// adds the counts in the file, returns false if it cannot be read
+        /// or is not a histogram
+        bool Load(const std::string & fileName);
+        bool Save(const std::string & fileName) const;
+        /// p50, p99 and max for each band
+        void PrintReport(std::ostream & os) const;
+
+       private:
+        static size_t   BucketOf(uint64_t us);
+        static uint64_t BucketTop(size_t bucket);  // the largest us in it
+
+        using Counts = std::array<uint64_t, Buckets>;
+        std::array<std::array<Counts, nBlockTypes>, Bands> _counts;
+        std::array<uint64_t, Bands>                        _max;
+    };
+
+}  // namespace Bastet
+
+#endif  // LATENCY_HISTOGRAM_HPP
@@ -0,0 +1,131 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OpeningBook.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace Bastet {
+
+    namespace {
+        struct Header {
+            char     magic[4];
+            uint32_t version;
+            uint32_t mode;
+            uint16_t width;  // of the well the scores were searched in
+            uint16_t height;
+            uint64_t size;  // entries, which follow the header
+        };
+
+        const char Magic[4] = {'B', 'S', 'T', 'B'};
+        // the scores depend on Evaluate and on the search: any change to
+        // them must bump the version, so that old books are not used
+        const uint32_t Version = 2;
+
+        bool ByKey(const OpeningBook::Entry & a, const OpeningBook::Entry & b) {
+            return a.hash < b.hash || (a.hash == b.hash && a.block < b.block);
+        }
+    }  // namespace
+
+    OpeningBook::OpeningBook()
+        : _map(nullptr)
+        , _mapSize(0)
+        , _entries(nullptr)
+        , _size(0)
+        , _mode(SearchMode::Exact)
+        , _width(0)
+        , _height(0) {}
+
+    OpeningBook::~OpeningBook() { Close(); }
+
+    void OpeningBook::Close() {
+        if (_map) munmap(_map, _mapSize);
+        _map     = nullptr;
+        _mapSize = 0;
+        _entries = nullptr;
+        _size    = 0;
+    }
+
+    bool OpeningBook::Open(const std::string & fileName) {
+        Close();
+        const int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        void *      map = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header))
+            map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);  // the mapping stays
+        if (map == MAP_FAILED) return false;
+        _map     = map;
+        _mapSize = st.st_size;
+
+        const Header * h = static_cast<const Header *>(_map);
+        if (memcmp(h->magic, Magic, sizeof(Magic)) || h->version != Version
+            || h->mode > uint32_t(SearchMode::HardDrop)
+            || _mapSize != sizeof(Header) + h->size * sizeof(Entry)) {
+            Close();
+            return false;
+        }
+        _entries = reinterpret_cast<const Entry *>(h + 1);
+        _size    = h->size;
+        _mode    = SearchMode(h->mode);
+        _width   = h->width;
+        _height  = h->height;
+        return true;
+    }
+
+    bool OpeningBook::Lookup(uint64_t hash, BlockType b,
+                             Scores & scores) const {
+        Entry key;
+        key.hash  = hash;
+        key.block = b;
+        const Entry * e
+            = std::lower_bound(_entries, _entries + _size, key, ByKey);
+        if (e == _entries + _size || e->hash != key.hash || e->block != b)
+            return false;
+        std::copy(e->scores, e->scores + nBlockTypes, scores.begin());
+        return true;
+    }
+
+    bool OpeningBook::Write(const std::string & fileName,
+                            std::vector<Entry> entries, SearchMode mode,
+                            int width, int height) {
+        std::sort(entries.begin(), entries.end(), ByKey);
+        Header h;
+        memcpy(h.magic, Magic, sizeof(Magic));
+        h.version = Version;
+        h.mode    = uint32_t(mode);
+        h.width   = width;
+        h.height  = height;
+        h.size    = entries.size();
+
+        std::ofstream ofs(fileName.c_str(), std::ios::binary);
+        ofs.write(reinterpret_cast<const char *>(&h), sizeof(h));
+        ofs.write(reinterpret_cast<const char *>(entries.data()),
+                  entries.size() * sizeof(Entry));
+        return bool(ofs);
+    }
+
+}  // namespace Bastet
@@ -0,0 +1,87 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPENING_BOOK_HPP
+#define OPENING_BOOK_HPP
+
+#include <array>
+#include <cstddef>  //size_t
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BastetBlockChooser.hpp"
+
+namespace Bastet {
+
+    /**
+     * main scores of BastetBlockChooser computed in advance for common (well,
+     * block) pairs, such as the ones of the first blocks of a game. The book
+     * is a file of entries sorted by key, mapped in memory rather than read,
+     * so a lookup is a binary search over pages loaded on demand
+     */
+    class OpeningBook {
+       public:
+        using Scores = std::array<long, nBlockTypes>;
+
+        struct Entry {
+            uint64_t hash;  // Well<G>::GetHash()
+            uint32_t block;
+            uint32_t unused;
+            int64_t  scores[nBlockTypes];
+        };
+
+        OpeningBook();
+        ~OpeningBook();
+        OpeningBook(const OpeningBook &) = delete;
+        OpeningBook & operator=(const OpeningBook &) = delete;
+
+        /// maps the file; returns false, leaving the book empty, if it is
+        /// missing or made by a version with other scores
+        bool Open(const std::string & fileName);
+        /// looks up the well of the given hash, which must be of the
+        /// geometry of the book
+        bool Lookup(uint64_t hash, BlockType b, Scores & scores) const;
+
+        size_t     GetSize() const { return _size; }
+        SearchMode GetSearchMode() const { return _mode; }
+        /// the geometry of the wells the scores were searched in
+        int GetWidth() const { return _width; }
+        int GetHeight() const { return _height; }
+
+        /// writes the entries as a book of scores searched with mode, in
+        /// wells of the given geometry
+        static bool Write(const std::string & fileName,
+                          std::vector<Entry> entries, SearchMode mode,
+                          int width, int height);
+
+       private:
+        void Close();
+
+        void *        _map;
+        size_t        _mapSize;
+        const Entry * _entries;
+        size_t        _size;
+        SearchMode    _mode;
+        int           _width;
+        int           _height;
+    };
+
+}  // namespace Bastet
+
+#endif  // OPENING_BOOK_HPP
@@ -0,0 +1,34 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Random.hpp"
+
+#include <chrono>
+#include <random>
+
+namespace Bastet {
+
+    uint64_t NewSeed() {
+        using namespace std::chrono;
+        std::random_device device;
+        const uint64_t     time
+            = high_resolution_clock::now().time_since_epoch().count();
+        return (uint64_t(device()) << 32 | device()) ^ time;
+    }
+
+}  // namespace Bastet
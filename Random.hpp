@@ -0,0 +1,66 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <cstdint>
+
+namespace Bastet {
+
+    /**
+     * the PCG32 generator (XSH-RR output on a 64-bit LCG state): small, fast,
+     * and with no hidden state shared between its instances, so that each
+     * block chooser can have its own and replay it from the seed
+     */
+    class Pcg32 {
+       public:
+        using result_type = uint32_t;
+
+        explicit Pcg32(uint64_t seed) : _state(0) {
+            (*this)();
+            _state += seed;
+            (*this)();
+        }
+
+        uint32_t operator()() {
+            const uint64_t old = _state;
+            _state             = old * Multiplier + Increment;
+            const uint32_t xorShifted = ((old >> 18) ^ old) >> 27;
+            const uint32_t rotation   = old >> 59;
+            return (xorShifted >> rotation)
+                   | (xorShifted << ((32 - rotation) & 31));
+        }
+        /// in [0,n): as random() % n was, but with no modulo
+        uint32_t Below(uint32_t n) { return uint64_t((*this)()) * n >> 32; }
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return UINT32_MAX; }
+
+       private:
+        static constexpr uint64_t Multiplier = 6364136223846793005ull;
+        static constexpr uint64_t Increment  = 1442695040888963407ull;
+        uint64_t                  _state;
+    };
+
+    /// a different seed at each call, for the games that are not replays
+    uint64_t NewSeed();
+
+}  // namespace Bastet
+
+#endif  // RANDOM_HPP
@@ -0,0 +1,273 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Replay.hpp"
+
+#include <boost/format.hpp>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include "BastetBlockChooser.hpp"
+#include "Well.hpp"
+
+using namespace std;
+
+namespace Bastet {
+
+    // the file starts with Magic and Version, then
+    //   chooser (1 byte), seed (8 bytes, little endian),
+    //   width, height (1 byte each),
+    //   starting queue: count, then a byte for each block,
+    //   pieces: count, then for each piece
+    //     block | next << 3 | hasNext << 6 (1 byte),
+    //     inputs: count, then ms since the last input << 3 | action,
+    //     x, y (1 byte each, signed), orientation | depth << 2 (1 byte)
+    // where counts and inputs are LEB128 varints
+    static const string  Magic   = "BSTR";
+    static const uint8_t Version = 3;
+
+    namespace {
+        class Writer {
+           public:
+            void Byte(uint8_t b) { _bytes.push_back(b); }
+            void Varint(uint64_t v) {
+                for (; v >= 0x80; v >>= 7) Byte(uint8_t(v) | 0x80);
+                Byte(uint8_t(v));
+            }
+            const vector<uint8_t> & GetBytes() const { return _bytes; }
+
+           private:
+            vector<uint8_t> _bytes;
+        };
+
+        // reads past the end give zeros and make IsGood() false
+        class Reader {
+           public:
+            explicit Reader(vector<uint8_t> bytes)
+                : _bytes(move(bytes)), _next(0), _good(true) {}
+            uint8_t Byte() {
+                if (_next < _bytes.size()) return _bytes[_next++];
+                _good = false;
+                return 0;
+            }
+            uint64_t Varint() {
+                uint64_t v = 0;
+                for (int shift = 0; shift < 64; shift += 7) {
+                    const uint8_t b = Byte();
+                    v |= uint64_t(b & 0x7f) << shift;
+                    if (!(b & 0x80)) return v;
+                }
+                _good = false;
+                return 0;
+            }
+            bool IsGood() const { return _good; }
+            bool AtEnd() const { return _next == _bytes.size(); }
+
+           private:
+            vector<uint8_t> _bytes;
+            size_t          _next;
+            bool            _good;
+        };
+    }  // namespace
+
+    bool Replay::Save(const std::string & fileName) const {
+        Writer w;
+        for (char c : Magic) w.Byte(c);
+        w.Byte(Version);
+        w.Byte(uint8_t(chooser));
+        for (int i = 0; i < 8; ++i) w.Byte(seed >> (8 * i));
+        w.Byte(width);
+        w.Byte(height);
+        w.Varint(startingQueue.size());
+        for (BlockType b : startingQueue) w.Byte(b);
+        w.Varint(pieces.size());
+        for (const auto & p : pieces) {
+            w.Byte(p.block | p.next << 3 | p.hasNext << 6);
+            w.Varint(p.inputs.size());
+            uint32_t last = 0;
+            for (const auto & i : p.inputs) {
+                w.Varint(uint64_t(i.ms - last) << 3 | uint8_t(i.action));
+                last = i.ms;
+            }
+            w.Byte(p.locked.GetPos().x);
+            w.Byte(p.locked.GetPos().y);
+            w.Byte(p.locked.GetOrientation() | p.depth << 2);
+        }
+        ofstream ofs(fileName.c_str(), ios::binary);
+        ofs.write(reinterpret_cast<const char *>(w.GetBytes().data()),
+                  w.GetBytes().size());
+        return bool(ofs);
+    }
+
+    bool Replay::Load(const std::string & fileName) {
+        ifstream ifs(fileName.c_str(), ios::binary);
+        if (!ifs) return false;
+        Reader r(vector<uint8_t>{istreambuf_iterator<char>(ifs),
+                                 istreambuf_iterator<char>()});
+        for (char c : Magic)
+            if (r.Byte() != uint8_t(c)) return false;
+        if (r.Byte() != Version) return false;
+
+        Replay        replay;
+        const uint8_t c = r.Byte();
+        if (c > uint8_t(ChooserType::Random)) return false;
+        replay.chooser = ChooserType(c);
+        replay.seed    = 0;
+        for (int i = 0; i < 8; ++i)
+            replay.seed |= uint64_t(r.Byte()) << (8 * i);
+        replay.width  = r.Byte();
+        replay.height = r.Byte();
+        for (uint64_t n = r.Varint(); n > 0 && r.IsGood(); --n) {
+            const uint8_t b = r.Byte();
+            if (b >= nBlockTypes) return false;
+            replay.startingQueue.push_back(BlockType(b));
+        }
+        for (uint64_t n = r.Varint(); n > 0 && r.IsGood(); --n) {
+            ReplayPiece   p;
+            const uint8_t blocks = r.Byte();
+            p.block              = BlockType(blocks & 7);
+            p.next               = BlockType(blocks >> 3 & 7);
+            p.hasNext            = blocks >> 6 & 1;
+            if (p.block >= nBlockTypes || p.next >= nBlockTypes) return false;
+            uint32_t ms = 0;
+            for (uint64_t i = r.Varint(); i > 0 && r.IsGood(); --i) {
+                const uint64_t input = r.Varint();
+                if ((input & 7) > uint8_t(Action::Gravity)) return false;
+                ms += input >> 3;
+                p.inputs.push_back(ReplayInput{ms, Action(input & 7)});
+            }
+            const int8_t  x = r.Byte();
+            const int8_t  y = r.Byte();
+            const uint8_t o = r.Byte();
+            p.locked        = BlockPosition(Dot{x, y}, Orientation(o & 3));
+            p.depth         = o >> 2;
+            replay.pieces.push_back(move(p));
+        }
+        if (!r.IsGood() || !r.AtEnd()) return false;
+        *this = move(replay);
+        return true;
+    }
+
+    template<typename G>
+    static unique_ptr<BlockChooser<G>> MakeChooser(ChooserType type,
+                                                   unsigned    threads,
+                                                   uint64_t    seed) {
+        switch (type) {
+            case ChooserType::Bastet:
+                return unique_ptr<BlockChooser<G>>(new BastetBlockChooser<G>(
+                    threads, TranspositionTable::DefaultLog2Size,
+                    SearchMode::Exact, seed));
+            case ChooserType::NoPreview:
+                return unique_ptr<BlockChooser<G>>(
+                    new NoPreviewBlockChooser<G>(seed));
+            case ChooserType::Deep:
+                // the depths come from the replay, so no time limit
+                return unique_ptr<BlockChooser<G>>(new DeepBlockChooser<G>(
+                    chrono::hours(1), DeepBlockChooser<G>::DefaultMaxDepth,
+                    threads, TranspositionTable::DefaultLog2Size,
+                    SearchMode::Exact, seed));
+            case ChooserType::Random:
+                break;
+        }
+        return unique_ptr<BlockChooser<G>>(new RandomBlockChooser<G>(seed));
+    }
+
+    static ReplayCheck Mismatch(size_t piece, const string & what) {
+        return ReplayCheck{piece, false,
+                           str(boost::format("piece %d: %s") % piece % what)};
+    }
+
+    template<typename G>
+    static ReplayCheck Check(const Replay & r, unsigned threads) {
+        auto bc = MakeChooser<G>(r.chooser, threads, r.seed);
+        Queue q = bc->GetStartingQueue();
+        Queue expected;
+        for (BlockType b : r.startingQueue) expected.push(b);
+        if (q != expected) return Mismatch(0, "different starting blocks");
+
+        Well<G> w;
+        for (size_t i = 0; i < r.pieces.size(); ++i) {
+            const ReplayPiece & piece = r.pieces[i];
+            if (q.empty() || q.front() != piece.block)
+                return Mismatch(i, "a different block falls");
+            q.pop();
+
+            // as in Ui::DropBlock, the block locks when it cannot go down
+            BlockType     b = piece.block;
+            BlockPosition p      = BlockPosition::Start<G>();
+            bool          locked = false;
+            for (const auto & input : piece.inputs) {
+                if (locked) return Mismatch(i, "inputs after the lock");
+                switch (input.action) {
+                    case Action::Left:
+                        p.MoveIfPossible(Left, b, &w);
+                        break;
+                    case Action::Right:
+                        p.MoveIfPossible(Right, b, &w);
+                        break;
+                    case Action::RotateCW:
+                        p.MoveIfPossible(RotateCW, b, &w);
+                        break;
+                    case Action::RotateCCW:
+                        p.MoveIfPossible(RotateCCW, b, &w);
+                        break;
+                    case Action::Down:
+                    case Action::Gravity:
+                        locked = !p.MoveIfPossible(Down, b, &w);
+                        break;
+                    case Action::Drop:
+                        p.Drop(b, &w);
+                        locked = true;
+                        break;
+                }
+            }
+            if (!locked) return Mismatch(i, "the inputs do not lock it");
+            if (!(p == piece.locked))
+                return Mismatch(i, "it locks somewhere else");
+            if (w.TryLockAndClearLines(b, p) == Well<G>::LockedOut) {
+                if (piece.hasNext || i + 1 != r.pieces.size())
+                    return Mismatch(i, "the game ends here");
+                return ReplayCheck{i + 1, true, ""};
+            }
+            if (!piece.hasNext) return Mismatch(i, "the game goes on");
+
+            if (r.chooser == ChooserType::Deep)
+                static_cast<DeepBlockChooser<G> *>(bc.get())
+                    ->SetMaxDepth(piece.depth);
+            const BlockType next = bc->GetNext(&w, q);
+            if (next != piece.next)
+                return Mismatch(
+                    i, str(boost::format("the chooser gives %c, not %c")
+                           % GetChar(next) % GetChar(piece.next)));
+            q.push(next);
+        }
+        return ReplayCheck{r.pieces.size(), true, ""};
+    }
+
+    ReplayCheck CheckReplay(const Replay & r, unsigned threads) {
+#define CHECK(G)                                                               \
+    if (r.width == G::Width && r.height == G::Height)                          \
+        return Check<G>(r, threads);
+        BASTET_GEOMETRIES(CHECK)
+#undef CHECK
+        return ReplayCheck{0, false, "a well of unknown geometry"};
+    }
+
+}  // namespace Bastet
@@ -0,0 +1,95 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <cstddef>  //size_t
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Block.hpp"
+#include "BlockPosition.hpp"
+
+namespace Bastet {
+
+    /// the block choosers a game can be played against
+    enum class ChooserType : uint8_t { Bastet, NoPreview, Deep, Random };
+
+    /// what moved the falling block: a key of the player, or the time
+    enum class Action : uint8_t {
+        Left,
+        Right,
+        Down,
+        RotateCW,
+        RotateCCW,
+        Drop,
+        Gravity
+    };
+
+    struct ReplayInput {
+        uint32_t ms;  // since the block appeared
+        Action   action;
+    };
+
+    struct ReplayPiece {
+        BlockType                block;  // the falling one
+        std::vector<ReplayInput> inputs;
+        BlockPosition            locked;   // where the inputs left it
+        bool                     hasNext;  // false if it ended the game
+        BlockType                next;     // what the chooser gave after it
+        uint8_t                  depth;    // of the search of a deep chooser
+    };
+
+    /**
+     * a whole game, as a compact binary log: the seed of the random choices,
+     * the chooser, the size of the well, and for each block the inputs of
+     * the player, where it locked and what the chooser gave next. Choosers
+     * are deterministic given the seed, except for the time budget of the
+     * deep one, which is why its search depth is kept too
+     */
+    struct Replay {
+        ChooserType              chooser;
+        uint64_t                 seed;    // of the chooser
+        uint8_t                  width;   // of the well
+        uint8_t                  height;
+        std::vector<BlockType>   startingQueue;
+        std::vector<ReplayPiece> pieces;
+
+        bool Save(const std::string & fileName) const;
+        /// returns false if the file cannot be read or is not a replay
+        bool Load(const std::string & fileName);
+    };
+
+    struct ReplayCheck {
+        size_t      pieces;  // played again, up to the first difference
+        bool        matches;
+        std::string error;  // the first difference
+    };
+
+    /**
+     * plays r again with no delays: moves each block by its inputs through
+     * the well, checks that it locks where it did, and that a new chooser of
+     * the same type with the same seed makes the same choices
+     */
+    ReplayCheck CheckReplay(const Replay & r, unsigned threads = 1);
+
+}  // namespace Bastet
+
+#endif  // REPLAY_HPP
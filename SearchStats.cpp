@@ -0,0 +1,134 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SearchStats.hpp"
+
+#include <mutex>
+
+namespace Bastet {
+
+    SearchStats & SearchStats::operator+=(const SearchStats & s) {
+        for (size_t i = 0; i < nCounters; ++i) counts[i] += s.counts[i];
+        getNextCalls += s.getNextCalls;
+        getNextNs += s.getNextNs;  // lastGetNextNs is not a count: kept
+        return *this;
+    }
+
+    SearchStats & SearchStats::operator-=(const SearchStats & s) {
+        for (size_t i = 0; i < nCounters; ++i) counts[i] -= s.counts[i];
+        getNextCalls -= s.getNextCalls;
+        getNextNs -= s.getNextNs;
+        return *this;
+    }
+
+#ifdef BASTET_STATS
+    namespace {
+        std::mutex                    registryMutex;
+        std::vector<ThreadCounters *> running;  // guarded by registryMutex
+        SearchStats                   finished{};
+        SearchStats                   baseline{};  // at the last ResetStats
+        std::vector<SearchStats>      threadBaselines;
+
+        SearchStats Read(const ThreadCounters & t) {
+            SearchStats s{};
+            for (size_t i = 0; i < nCounters; ++i)
+                s.counts[i] = t.counts[i].load(std::memory_order_relaxed);
+            return s;
+        }
+
+        std::atomic<uint64_t> getNextCalls(0);
+        std::atomic<uint64_t> getNextNs(0);
+        std::atomic<uint64_t> lastGetNextNs(0);
+    }  // namespace
+
+    thread_local ThreadCounters threadCounters;
+
+    ThreadCounters::ThreadCounters() {
+        for (auto & c : counts) c.store(0, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(registryMutex);
+        running.push_back(this);
+    }
+
+    ThreadCounters::~ThreadCounters() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (size_t i = 0; i < running.size(); ++i) {
+            if (running[i] != this) continue;
+            finished += Read(*this);
+            running.erase(running.begin() + i);
+            if (i < threadBaselines.size())
+                threadBaselines.erase(threadBaselines.begin() + i);
+            break;
+        }
+    }
+
+    GetNextTimer::~GetNextTimer() {
+        using namespace std::chrono;
+        const uint64_t ns
+            = duration_cast<nanoseconds>(steady_clock::now() - _start).count();
+        getNextCalls.fetch_add(1, std::memory_order_relaxed);
+        getNextNs.fetch_add(ns, std::memory_order_relaxed);
+        lastGetNextNs.store(ns, std::memory_order_relaxed);
+    }
+
+    static SearchStats Total() {
+        SearchStats s = finished;
+        for (const auto * t : running) s += Read(*t);
+        s.getNextCalls  = getNextCalls.load(std::memory_order_relaxed);
+        s.getNextNs     = getNextNs.load(std::memory_order_relaxed);
+        s.lastGetNextNs = lastGetNextNs.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    SearchStats CollectStats() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        SearchStats                 s = Total();
+        s -= baseline;
+        return s;
+    }
+
+    std::vector<SearchStats> CollectThreadStats() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        threadBaselines.resize(running.size(), SearchStats{});
+        std::vector<SearchStats> stats;
+        for (size_t i = 0; i < running.size(); ++i) {
+            stats.push_back(Read(*running[i]));
+            stats.back() -= threadBaselines[i];
+        }
+        return stats;
+    }
+
+    // the counters belong to their threads, so they are never cleared: the
+    // counts are taken relative to the ones at the last reset instead
+    void ResetStats() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        baseline = Total();
+        lastGetNextNs.store(0, std::memory_order_relaxed);
+        threadBaselines.clear();
+        for (const auto * t : running) threadBaselines.push_back(Read(*t));
+    }
+#else
+    SearchStats CollectStats() { return SearchStats{}; }
+
+    std::vector<SearchStats> CollectThreadStats() {
+        return std::vector<SearchStats>();
+    }
+
+    void ResetStats() {}
+#endif
+
+}  // namespace Bastet
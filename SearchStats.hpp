@@ -0,0 +1,103 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEARCH_STATS_HPP
+#define SEARCH_STATS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>  //size_t
+#include <cstdint>
+#include <vector>
+
+namespace Bastet {
+
+    /// what the search engine counts, when built with BASTET_STATS
+    enum class Counter {
+        Vertices,        // positions reached by Searcher
+        Visits,          // landings given to a visitor
+        Evaluations,     // calls to Evaluate
+        GameOverPrunes,  // landings dropped because the block locks out
+        WellCopies,      // copies of the well made by the choosers
+        BookHits,        // main scores found in the opening book
+    };
+    static constexpr size_t nCounters = 6;
+
+    struct SearchStats {
+        std::array<uint64_t, nCounters> counts;
+        uint64_t                        getNextCalls;
+        uint64_t                        getNextNs;      // all the calls
+        uint64_t                        lastGetNextNs;  // the last one
+
+        uint64_t Get(Counter c) const { return counts[size_t(c)]; }
+        double   AverageGetNextNs() const {
+            return getNextCalls ? double(getNextNs) / getNextCalls : 0;
+        }
+        SearchStats & operator+=(const SearchStats & s);
+        SearchStats & operator-=(const SearchStats & s);
+    };
+
+#ifdef BASTET_STATS
+    static constexpr bool StatsEnabled = true;
+
+    /// the counters of one thread: only that thread writes them, so plain
+    /// loads and stores are enough, and other threads can still read them
+    struct ThreadCounters {
+        ThreadCounters();
+        ~ThreadCounters();  // keeps the counts of the finished thread
+        std::array<std::atomic<uint64_t>, nCounters> counts;
+    };
+    extern thread_local ThreadCounters threadCounters;
+
+    inline void Count(Counter c, uint64_t n = 1) {
+        auto & a = threadCounters.counts[size_t(c)];
+        a.store(a.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+    }
+#else
+    static constexpr bool StatsEnabled = false;
+
+    inline void Count(Counter /*c*/, uint64_t /*n*/ = 1) {}
+#endif
+
+    /// the counts of all the threads since the last ResetStats, the finished
+    /// ones included (all zeros without BASTET_STATS)
+    SearchStats CollectStats();
+    /// the counts of each running thread since the last ResetStats
+    std::vector<SearchStats> CollectThreadStats();
+    void                     ResetStats();
+
+    /// times a BlockChooser::GetNext call, from its construction to its
+    /// destruction
+    class GetNextTimer {
+       public:
+#ifdef BASTET_STATS
+        GetNextTimer() : _start(std::chrono::steady_clock::now()) {}
+        ~GetNextTimer();
+
+       private:
+        std::chrono::steady_clock::time_point _start;
+#else
+        GetNextTimer() {}
+#endif
+    };
+
+}  // namespace Bastet
+
+#endif  // SEARCH_STATS_HPP
@@ -0,0 +1,308 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// bastet_sim: plays many complete games headlessly, on all the cores, with a
+// simple AI against one of the block choosers, to measure how strong and how
+// expensive the chooser is.
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BastetBlockChooser.hpp"
+#include "OpeningBook.hpp"
+#include "SearchStats.hpp"
+#include "Well.hpp"
+
+using namespace Bastet;
+using namespace std;
+
+namespace po = boost::program_options;
+
+namespace {
+
+    using Clock = chrono::steady_clock;
+
+    struct Options {
+        string        chooser;
+        SearchMode    mode;
+        int           budget;  // ms, for the deep chooser
+        int           maxPieces;
+        unsigned      tableBits;  // for the bastet and deep choosers
+        OpeningBook * book;       // for the bastet and deep choosers
+    };
+
+    struct GameResult {
+        int                       lines;
+        int                       pieces;
+        double                    chooserSeconds;     // total spent in GetNext
+        double                    maxChooserSeconds;  // longest GetNext
+        TranspositionTable::Stats table;  // of the bastet and deep choosers
+    };
+
+    template<typename G>
+    unique_ptr<BlockChooser<G>> MakeChooser(const Options & o, uint64_t seed) {
+        BastetBlockChooser<G> * bc = nullptr;
+        if (o.chooser == "bastet")
+            bc = new BastetBlockChooser<G>(1, o.tableBits, o.mode, seed);
+        else if (o.chooser == "deep")
+            bc = new DeepBlockChooser<G>(chrono::milliseconds(o.budget),
+                                         DeepBlockChooser<G>::DefaultMaxDepth,
+                                         1, o.tableBits, o.mode, seed);
+        if (bc) {
+            bc->SetOpeningBook(o.book);
+            return unique_ptr<BlockChooser<G>>(bc);
+        }
+        if (o.chooser == "nopreview")
+            return unique_ptr<BlockChooser<G>>(
+                new NoPreviewBlockChooser<G>(seed));
+        if (o.chooser == "random")
+            return unique_ptr<BlockChooser<G>>(new RandomBlockChooser<G>(seed));
+        return nullptr;
+    }
+
+    /// the player: drops b where Evaluate likes the result best, and returns
+    /// the lines cleared, or Well<G>::LockedOut if there is nowhere to put it
+    template<typename G>
+    int PlaceBlock(Well<G> * w, BlockType b) {
+        const BlockPosition start = BlockPosition::Start<G>();
+        if (!start.IsValid(b, w)) return Well<G>::LockedOut;
+        LandingsVisitor<G> v;
+        Searcher<G>(b, w, start, &v);
+        const Vertex * best      = nullptr;
+        long           bestScore = 0;
+        int            bestLines = 0;
+        for (const Vertex & l : v.GetLandings()) {
+            WellUndo<G> undo;
+            const int   lines = w->TryLockAndClearLines(b, l, undo);
+            if (lines == Well<G>::LockedOut) continue;
+            const long score = Evaluate(w, lines);
+            w->Undo(undo);
+            if (!best || score > bestScore) {
+                best      = &l;
+                bestScore = score;
+                bestLines = lines;
+            }
+        }
+        if (!best) return Well<G>::LockedOut;
+        w->TryLockAndClearLines(b, *best);
+        return bestLines;
+    }
+
+    template<typename G>
+    GameResult PlayGame(BlockChooser<G> * bc, int maxPieces) {
+        GameResult r{0, 0, 0, 0, {}};
+        Well<G>    w;
+        Queue      q = bc->GetStartingQueue();
+        while (r.pieces < maxPieces) {
+            const BlockType current = q.front();
+            q.pop();
+            const int lines = PlaceBlock(&w, current);
+            if (lines == Well<G>::LockedOut) break;
+            r.lines += lines;
+            ++r.pieces;
+
+            const auto start = Clock::now();
+            q.push(bc->GetNext(&w, q));
+            const double s
+                = chrono::duration<double>(Clock::now() - start).count();
+            r.chooserSeconds += s;
+            r.maxChooserSeconds = max(r.maxChooserSeconds, s);
+        }
+        if (auto * bbc = dynamic_cast<BastetBlockChooser<G> *>(bc))
+            r.table = bbc->GetTableStats();
+        return r;
+    }
+
+    // each thread takes the next game to play until there are none left.
+    // Every game has its own chooser and seed, so that the results do not
+    // depend on which thread plays it
+    template<typename G>
+    void PlayGames(const Options & o, uint64_t seed, int threads,
+                   vector<GameResult> & results) {
+        const int      games = results.size();
+        atomic<int>    next(0);
+        vector<thread> workers;
+        for (int t = 0; t < threads; ++t)
+            workers.emplace_back([&] {
+                for (int g; (g = next++) < games;)
+                    results[g] = PlayGame(MakeChooser<G>(o, seed + g).get(),
+                                          o.maxPieces);
+            });
+        for (auto & t : workers) t.join();
+    }
+
+}  // namespace
+
+int main(int argc, char ** argv) {
+    Options  o;
+    int      games, threads;
+    uint64_t seed;
+    string   mode, book, geometry;
+
+    po::options_description opts("Options");
+    opts.add_options()("help,h", "show this help")(
+        "games,n", po::value<int>(&games)->default_value(100),
+        "number of games to play")(
+        "threads,j",
+        po::value<int>(&threads)->default_value(
+            max(1u, thread::hardware_concurrency())),
+        "games played at the same time")(
+        "chooser,c", po::value<string>(&o.chooser)->default_value("bastet"),
+        "block chooser: bastet, deep, nopreview or random")(
+        "mode,m", po::value<string>(&mode)->default_value("exact"),
+        "search of the bastet and deep choosers: exact or harddrop")(
+        "budget,b", po::value<int>(&o.budget)->default_value(30),
+        "time budget of the deep chooser, in ms")(
+        "max-pieces", po::value<int>(&o.maxPieces)->default_value(100000),
+        "stop a game after this many pieces")(
+        "table-bits",
+        po::value<unsigned>(&o.tableBits)
+            ->default_value(TranspositionTable::DefaultLog2Size),
+        "the tables of the bastet and deep choosers hold 2^bits entries")(
+        "book", po::value<string>(&book),
+        "opening book of the bastet and deep choosers")(
+        "geometry,g", po::value<string>(&geometry)->default_value("10x20"),
+        "well, width x height: 10x20, 16x20 or 10x30")(
+        "seed", po::value<uint64_t>(&seed)->default_value(1),
+        "game g is played with a chooser seeded with seed+g")(
+        "per-game", "print the result of each game");
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, opts), vm);
+        po::notify(vm);
+    } catch (const po::error & e) {
+        cerr << e.what() << "\n" << opts;
+        return 2;
+    }
+    if (vm.count("help")) {
+        cout << opts;
+        return 0;
+    }
+    if (mode == "exact")
+        o.mode = SearchMode::Exact;
+    else if (mode == "harddrop")
+        o.mode = SearchMode::HardDrop;
+    else {
+        cerr << "unknown search mode " << mode << "\n";
+        return 2;
+    }
+    OpeningBook openingBook;
+    o.book = nullptr;
+    if (!book.empty()) {
+        if (!openingBook.Open(book)) {
+            cerr << "cannot open the opening book " << book << "\n";
+            return 2;
+        }
+        o.book = &openingBook;
+    }
+    if (!MakeChooser<StandardGeometry>(o, seed)) {
+        cerr << "unknown chooser " << o.chooser << "\n";
+        return 2;
+    }
+    int width, height;
+    if (sscanf(geometry.c_str(), "%dx%d", &width, &height) != 2) {
+        cerr << "unknown geometry " << geometry << "\n";
+        return 2;
+    }
+    threads = max(1, min(threads, games));
+
+    vector<GameResult> results(max(games, 0));
+    const auto         start  = Clock::now();
+    bool               played = false;
+#define PLAY(G)                                                                \
+    if (!played && width == G::Width && height == G::Height) {                 \
+        PlayGames<G>(o, seed, threads, results);                               \
+        played = true;                                                         \
+    }
+    BASTET_GEOMETRIES(PLAY)
+#undef PLAY
+    if (!played) {
+        cerr << "unknown geometry " << geometry << "\n";
+        return 2;
+    }
+    const double elapsed
+        = chrono::duration<double>(Clock::now() - start).count();
+
+    if (vm.count("per-game")) {
+        printf("%6s %8s %8s %12s %12s\n", "game", "lines", "pieces",
+               "us/piece", "max us");
+        for (size_t g = 0; g < results.size(); ++g) {
+            const auto & r = results[g];
+            printf("%6zu %8d %8d %12.1f %12.1f\n", g, r.lines, r.pieces,
+                   r.pieces ? r.chooserSeconds * 1e6 / r.pieces : 0.,
+                   r.maxChooserSeconds * 1e6);
+        }
+    }
+
+    long                      lines = 0, pieces = 0;
+    double                    chooserSeconds = 0, maxChooserSeconds = 0;
+    int                       minLines = results.empty() ? 0 : results[0].lines;
+    int                       maxLines = 0;
+    TranspositionTable::Stats table{};
+    for (const auto & r : results) {
+        lines += r.lines;
+        pieces += r.pieces;
+        table += r.table;
+        chooserSeconds += r.chooserSeconds;
+        maxChooserSeconds = max(maxChooserSeconds, r.maxChooserSeconds);
+        minLines          = min(minLines, r.lines);
+        maxLines          = max(maxLines, r.lines);
+    }
+    const double n = max(games, 1);
+    printf("chooser %s (%s), %s well, %d games on %d threads\n",
+           o.chooser.c_str(), mode.c_str(), geometry.c_str(), games, threads);
+    printf("lines per game:   %.2f (min %d, max %d)\n", lines / n, minLines,
+           maxLines);
+    printf("pieces per game:  %.2f\n", pieces / n);
+    printf("chooser time:     %.1f us/piece (max %.1f us)\n",
+           pieces ? chooserSeconds * 1e6 / pieces : 0.,
+           maxChooserSeconds * 1e6);
+    printf("throughput:       %.2f games/s, %.0f pieces/s\n", games / elapsed,
+           pieces / elapsed);
+    if (o.chooser == "bastet" || o.chooser == "deep")
+        printf("tables:           2^%u entries, %" PRIu64 " probes, %" PRIu64
+               " hits (%.1f%%), %" PRIu64 " evictions\n",
+               o.tableBits, table.probes, table.hits, 100 * table.HitRate(),
+               table.evictions);
+
+    if (StatsEnabled) {
+        // the threads are gone, their counts are kept all the same. They
+        // include the searches of the player
+        const SearchStats stats = CollectStats();
+        const double      calls = max<uint64_t>(stats.getNextCalls, 1);
+        printf("per piece:        %.0f vertices, %.0f visits, %.0f evaluations,"
+               " %.0f game over prunes, %.0f well copies, %.2f book hits\n",
+               stats.Get(Counter::Vertices) / calls,
+               stats.Get(Counter::Visits) / calls,
+               stats.Get(Counter::Evaluations) / calls,
+               stats.Get(Counter::GameOverPrunes) / calls,
+               stats.Get(Counter::WellCopies) / calls,
+               stats.Get(Counter::BookHits) / calls);
+    }
+}
@@ -6,15 +6,15 @@
 int main() {
     using namespace Bastet;
     using namespace std;
-    Well *        w = new Well;
-    BlockPosition p;
+    Well<StandardGeometry> * w = new Well<StandardGeometry>;
+    BlockPosition            p = BlockPosition::Start<StandardGeometry>();
     p.Drop(Z, w);
     w->LockAndClearLines(Z, p);
     cout << w->PrettyPrint() << endl;
     cout << "Score:" << Evaluate(w) << endl;
 
     w->Clear();
-    BlockPosition p2;
+    BlockPosition p2 = BlockPosition::Start<StandardGeometry>();
     p2.Drop(I, w);
     w->LockAndClearLines(I, p2);
     cout << w->PrettyPrint() << endl;
@@ -0,0 +1,76 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPool.hpp"
+
+namespace Bastet {
+
+    ThreadPool::ThreadPool(unsigned size)
+        : _job(nullptr), _n(0), _next(0), _busy(0), _batch(0), _stop(false) {
+        for (unsigned i = 1; i < size; ++i)
+            _workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto & t : _workers) t.join();
+    }
+
+    void ThreadPool::RunJobs(unsigned thread) {
+        for (size_t i = _next++; i < _n; i = _next++) (*_job)(i, thread);
+    }
+
+    void ThreadPool::WorkerLoop(unsigned thread) {
+        unsigned seen = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _wake.wait(lock, [&] { return _stop || _batch != seen; });
+            if (_stop) return;
+            seen = _batch;
+            lock.unlock();
+            RunJobs(thread);
+            lock.lock();
+            if (--_busy == 0) _done.notify_one();
+        }
+    }
+
+    void ThreadPool::ParallelFor(size_t n, const Job & job) {
+        if (_workers.empty() || n <= 1) {
+            for (size_t i = 0; i < n; ++i) job(i, 0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _job  = &job;
+            _n    = n;
+            _next = 0;
+            _busy = _workers.size();
+            _batch++;
+        }
+        _wake.notify_all();
+        RunJobs(0);
+        // the workers may still be finishing their last job
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [&] { return _busy == 0; });
+    }
+
+}  // namespace Bastet
@@ -0,0 +1,71 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>  //size_t
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Bastet {
+
+    /**
+     * a fixed set of worker threads to spread independent jobs over. The
+     * thread calling ParallelFor works too, so a pool of size 1 has no workers
+     * and simply runs everything in the caller
+     */
+    class ThreadPool {
+       public:
+        explicit ThreadPool(unsigned size = 1);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool & operator=(const ThreadPool &) = delete;
+
+        unsigned GetSize() const { return _workers.size() + 1; }
+        /// the job is called as job(i, thread) for each i in [0,n), where
+        /// thread in [0,GetSize()) tells which thread of the pool runs it (0 is
+        /// the caller)
+        using Job = std::function<void(size_t, unsigned)>;
+        /// runs the jobs in any order, returns when all are done; the jobs
+        /// must not call ParallelFor
+        void ParallelFor(size_t n, const Job & job);
+
+       private:
+        void WorkerLoop(unsigned thread);
+        void RunJobs(unsigned thread);
+
+        std::vector<std::thread> _workers;
+        std::mutex               _mutex;
+        std::condition_variable  _wake;  // a new batch has arrived
+        std::condition_variable  _done;  // a worker has finished it
+        const Job *              _job;
+        size_t                   _n;
+        std::atomic<size_t>      _next;  // next job to be taken
+        unsigned                 _busy;  // workers on this batch
+        unsigned                 _batch;
+        bool                     _stop;
+    };
+
+}  // namespace Bastet
+
+#endif  // THREAD_POOL_HPP
@@ -0,0 +1,97 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TranspositionTable.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace Bastet {
+
+    constexpr unsigned TranspositionTable::DefaultLog2Size;
+    const long         TranspositionTable::EmptyScore
+        = std::numeric_limits<long>::min();
+
+    TranspositionTable::Stats & TranspositionTable::Stats::operator+=(
+        const Stats & s) {
+        probes += s.probes;
+        hits += s.hits;
+        stores += s.stores;
+        evictions += s.evictions;
+        return *this;
+    }
+
+    TranspositionTable::TranspositionTable(unsigned log2Size)
+        : _shift(0), _stats() {
+        if (log2Size == 0) return;  // holds nothing
+        log2Size = std::min(std::max(log2Size, 2u), 32u);
+        _entries.resize(size_t(1) << log2Size);
+        _shift = 64 - (log2Size - 1);  // one bucket every two entries
+        Clear();
+    }
+
+    void TranspositionTable::Clear() {
+        for (auto & e : _entries) e = Entry{0, EmptyScore};
+    }
+
+    uint64_t TranspositionTable::Key(uint64_t wellHash, BlockType b,
+                                     int bonusLines) {
+        // the deep search adds up the lines of several blocks, so
+        // bonusLines gets its own byte: no two (b, bonusLines) pairs give the
+        // same field, and the multiplier is odd, so neither the same product
+        assert(bonusLines >= 0 && bonusLines < 256);
+        const uint64_t field = (uint64_t(b) << 8 | uint8_t(bonusLines)) + 1;
+        return wellHash ^ (0x9e3779b97f4a7c15ull * field);
+    }
+
+    TranspositionTable::Entry * TranspositionTable::Bucket(uint64_t key) {
+        return &_entries[(key >> _shift) * 2];
+    }
+
+    bool TranspositionTable::Probe(uint64_t wellHash, BlockType b,
+                                   int bonusLines, long & score) {
+        _stats.probes++;
+        if (_entries.empty()) return false;
+        const uint64_t key    = Key(wellHash, b, bonusLines);
+        Entry *        bucket = Bucket(key);
+        for (int k = 0; k < 2; ++k) {
+            if (bucket[k].key == key && bucket[k].score != EmptyScore) {
+                if (k == 1) std::swap(bucket[0], bucket[1]);
+                score = bucket[0].score;
+                _stats.hits++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void TranspositionTable::Store(uint64_t wellHash, BlockType b,
+                                   int bonusLines, long score) {
+        _stats.stores++;
+        if (_entries.empty()) return;
+        const uint64_t key    = Key(wellHash, b, bonusLines);
+        Entry *        bucket = Bucket(key);
+        if (bucket[0].key != key) {
+            if (bucket[1].score != EmptyScore) _stats.evictions++;
+            bucket[1] = bucket[0];
+        }
+        bucket[0] = Entry{key, score};
+    }
+
+}  // namespace Bastet
@@ -0,0 +1,83 @@
+/*
+    Bastet - tetris clone with embedded bastard block chooser
+    (c) 2005-2009 Federico Poloni <f.polonithirtyseven@sns.it> minus 37
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+
+#include <cstddef>  //size_t
+#include <cstdint>
+#include <vector>
+
+#include "Block.hpp"
+
+namespace Bastet {
+
+    /**
+     * fixed-size cache of second-level BestScore results, keyed by (well hash,
+     * block, bonus lines). The table is split in buckets of two entries kept in
+     * most-recently-used order: a new entry evicts the least recently used one
+     */
+    class TranspositionTable {
+       public:
+        struct Stats {
+            uint64_t probes;
+            uint64_t hits;
+            uint64_t stores;
+            uint64_t evictions;  // stores which pushed out a live entry
+
+            double HitRate() const {
+                return probes ? double(hits) / probes : 0;
+            }
+            Stats & operator+=(const Stats & s);
+        };
+
+        /// the size of the tables of the choosers unless told otherwise
+        static constexpr unsigned DefaultLog2Size = 16;
+
+        /// the table holds 2^log2Size entries, log2Size in [2,32]; 0 gives a
+        /// table which holds nothing, to compare with
+        explicit TranspositionTable(unsigned log2Size = DefaultLog2Size);
+
+        /// on a hit, returns true and sets score
+        bool Probe(uint64_t wellHash, BlockType b, int bonusLines,
+                   long & score);
+        void Store(uint64_t wellHash, BlockType b, int bonusLines, long score);
+        void Clear();
+
+        size_t        GetSize() const { return _entries.size(); }
+        const Stats & GetStats() const { return _stats; }
+        void          ResetStats() { _stats = Stats(); }
+
+       private:
+        struct Entry {
+            uint64_t key;
+            long     score;  // EmptyScore if the entry is unused
+        };
+        static const long EmptyScore;
+
+        static uint64_t Key(uint64_t wellHash, BlockType b, int bonusLines);
+        Entry *         Bucket(uint64_t key);
+
+        std::vector<Entry> _entries;
+        unsigned           _shift;  // key >> _shift gives the bucket
+        Stats              _stats;
+    };
+
+}  // namespace Bastet
+
+#endif  // TRANSPOSITION_TABLE_HPP
@@ -19,6 +19,7 @@
 #include "Ui.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <boost/algorithm/string.hpp>
 #include <boost/format.hpp>
 #include <cstdio>
@@ -34,6 +35,15 @@ using namespace boost;
 
 namespace Bastet {
 
+    Color GetColor(BlockType b) {
+        // O should be yellow, but I find no portable way to output a yellow
+        // solid block character in ncurses.
+        static const std::array<Color, nBlockTypes> colors
+            = {{COLOR_PAIR(7), COLOR_PAIR(4), COLOR_PAIR(1), COLOR_PAIR(5),
+                COLOR_PAIR(6), COLOR_PAIR(3), COLOR_PAIR(2)}};
+        return colors[b];
+    }
+
     Score & operator+=(Score & a, const Score & b) {
         a.first += b.first;
         a.second += b.second;
@@ -151,17 +161,27 @@ namespace Bastet {
         init_pair(20, COLOR_YELLOW, COLOR_BLACK);  // messages
         init_pair(21, COLOR_WHITE, COLOR_BLACK);   // window borders
         init_pair(22, COLOR_WHITE, COLOR_BLACK);   // end of line animation
-
-        /* Set random seed. */
-        srandom(time(nullptr) + 37);
     }
 
-    Ui::Ui()
-        : _level(0)
-        , _wellWin(WellHeight, 2 * WellWidth)
-        , _nextWin(5, 14, _wellWin.GetMinY(), _wellWin.GetMaxX() + 1)
-        , _scoreWin(7, 14, _nextWin.GetMaxY(), _nextWin.GetMinX()) {
+    Ui::Ui() : _level(0), _statsShown(), _replay(nullptr) {
+        Layout(StandardGeometry::Width, StandardGeometry::Height);
         for (auto & array : _colors) array.fill(0);
+        ForgetWell();
+    }
+
+    void Ui::Layout(int width, int height) {
+        // the old windows go first, they may overlap the new ones
+        _statsWin.reset();
+        _scoreWin.reset();
+        _nextWin.reset();
+        _wellWin.reset(new BorderedWindow(height, 2 * width));
+        _nextWin.reset(new BorderedWindow(5, 14, _wellWin->GetMinY(),
+                                          _wellWin->GetMaxX() + 1));
+        _scoreWin.reset(new BorderedWindow(7, 14, _nextWin->GetMaxY(),
+                                           _nextWin->GetMinX()));
+        if (StatsEnabled)
+            _statsWin.reset(new BorderedWindow(5, 14, _scoreWin->GetMaxY(),
+                                               _scoreWin->GetMinX()));
     }
 
     // returns x and y of the minimal
@@ -302,21 +322,33 @@ namespace Bastet {
     void Ui::RedrawStatic() {
         erase();
         wrefresh(stdscr);
-        _wellWin.RedrawBorder();
-        _nextWin.RedrawBorder();
-        _scoreWin.RedrawBorder();
-
-        wattrset((WINDOW *)_nextWin, COLOR_PAIR(17));
-        mvwprintw(_nextWin, 0, 0, " Next block:");
-        wrefresh(_nextWin);
-
-        wattrset((WINDOW *)_scoreWin, COLOR_PAIR(17));
-        mvwprintw(_scoreWin, 1, 0, "Score:");
-        wattrset((WINDOW *)_scoreWin, COLOR_PAIR(18));
-        mvwprintw(_scoreWin, 3, 0, "Lines:");
-        wattrset((WINDOW *)_scoreWin, COLOR_PAIR(19));
-        mvwprintw(_scoreWin, 5, 0, "Level:");
-        wrefresh(_scoreWin);
+        ForgetWell();
+        _wellWin->RedrawBorder();
+        _nextWin->RedrawBorder();
+        _scoreWin->RedrawBorder();
+
+        wattrset((WINDOW *)*_nextWin, COLOR_PAIR(17));
+        mvwprintw(*_nextWin, 0, 0, " Next block:");
+        wrefresh(*_nextWin);
+
+        wattrset((WINDOW *)*_scoreWin, COLOR_PAIR(17));
+        mvwprintw(*_scoreWin, 1, 0, "Score:");
+        wattrset((WINDOW *)*_scoreWin, COLOR_PAIR(18));
+        mvwprintw(*_scoreWin, 3, 0, "Lines:");
+        wattrset((WINDOW *)*_scoreWin, COLOR_PAIR(19));
+        mvwprintw(*_scoreWin, 5, 0, "Level:");
+        wrefresh(*_scoreWin);
+
+        if (_statsWin) {
+            _statsWin->RedrawBorder();
+            wattrset((WINDOW *)*_statsWin, COLOR_PAIR(17));
+            mvwprintw(*_statsWin, 0, 0, " Chooser:");
+            mvwprintw(*_statsWin, 1, 0, "last");
+            mvwprintw(*_statsWin, 2, 0, "avg");
+            mvwprintw(*_statsWin, 3, 0, "nodes");
+            mvwprintw(*_statsWin, 4, 0, "evals");
+            wrefresh(*_statsWin);
+        }
     }
 
     // must be <1E+06, because it should fit into a timeval usec field(see man
@@ -325,7 +357,26 @@ namespace Bastet {
         = {{999999, 770000, 593000, 457000, 352000, 271000, 208000, 160000,
             124000, 95000}};
 
-    void Ui::DropBlock(BlockType b, Well * w) {
+    // tells bc which well it will probably be asked about next, i.e. the one
+    // where the falling block has been dropped straight down from p
+    template<typename G>
+    static void SpeculateLanding(BlockChooser<G> * bc, const Queue & q,
+                                 const Well<G> * w, BlockType b,
+                                 BlockPosition p, BlockPosition & lastLanding) {
+        p.Drop(b, w);
+        if (p == lastLanding) return;
+        lastLanding = p;
+        Well<G> w2(*w);  // copy
+        if (w2.TryLockAndClearLines(b, p) != Well<G>::LockedOut)
+            bc->Speculate(&w2, q);
+    }
+
+    template<typename G>
+    void Ui::DropBlock(BlockType b, Well<G> * w, BlockChooser<G> * bc,
+                       const Queue & q) {
+        static_assert(G::Width <= std::tuple_size<ColorWellLine>::value
+                          && G::RealHeight == std::tuple_size<ColorWell>::value,
+                      "the well does not fit into _colors");
         fd_set         in, tmp_in;
         struct timeval time;
 
@@ -336,25 +387,42 @@ namespace Bastet {
         time.tv_usec = delay[_level];
 
         // assumes nodelay(stdscr,TRUE) has already been called
-        BlockPosition p;
+        BlockPosition p = BlockPosition::Start<G>();
+        BlockPosition landing(Dot{0, -100});  // none yet
 
         RedrawWell(w, b, p);
+        SpeculateLanding(bc, q, w, b, p, landing);
         auto * keys = config.GetKeys();
 
+        const auto appeared = chrono::steady_clock::now();
+        if (_replay)
+            _replay->pieces.push_back(ReplayPiece{b, {}, p, false, b, 0});
+        auto record = [&](Action a) {
+            if (!_replay) return;
+            const auto ms = chrono::duration_cast<chrono::milliseconds>(
+                chrono::steady_clock::now() - appeared);
+            _replay->pieces.back().inputs.push_back(
+                ReplayInput{uint32_t(ms.count()), a});
+        };
+
         while (true) {  // break = tetromino locked
             tmp_in      = in;
             int sel_ret = select(FD_SETSIZE, &tmp_in, NULL, NULL, &time);
             if (sel_ret == 0) {  // timeout
+                record(Action::Gravity);
                 if (!p.MoveIfPossible(Down, b, w)) break;
                 time.tv_sec  = 0;
                 time.tv_usec = delay[_level];
             } else {  // keypress
                 auto ch = getch();
-                if (ch == keys->Left)
+                if (ch == keys->Left) {
+                    record(Action::Left);
                     p.MoveIfPossible(Left, b, w);
-                else if (ch == keys->Right)
+                } else if (ch == keys->Right) {
+                    record(Action::Right);
                     p.MoveIfPossible(Right, b, w);
-                else if (ch == keys->Down) {
+                } else if (ch == keys->Down) {
+                    record(Action::Down);
                     bool val = p.MoveIfPossible(Down, b, w);
                     if (val) {
                         //_points++;
@@ -363,11 +431,14 @@ namespace Bastet {
                         time.tv_usec = delay[_level];
                     } else
                         break;
-                } else if (ch == keys->RotateCW)
+                } else if (ch == keys->RotateCW) {
+                    record(Action::RotateCW);
                     p.MoveIfPossible(RotateCW, b, w);
-                else if (ch == keys->RotateCCW)
+                } else if (ch == keys->RotateCCW) {
+                    record(Action::RotateCCW);
                     p.MoveIfPossible(RotateCCW, b, w);
-                else if (ch == keys->Drop) {
+                } else if (ch == keys->Drop) {
+                    record(Action::Drop);
                     p.Drop(b, w);
                     //_points+=2*fb.HardDrop(w);
                     // RedrawScore();
@@ -382,8 +453,10 @@ namespace Bastet {
 
             }  // keypress switch
             RedrawWell(w, b, p);
+            SpeculateLanding(bc, q, w, b, p, landing);
         }  // while(1)
 
+        if (_replay) _replay->pieces.back().locked = p;
         LinesCompleted lc = w->Lock(b, p);
         // locks also into _colors
 
@@ -423,70 +496,123 @@ namespace Bastet {
         }
     }
 
-    void Ui::RedrawWell(const Well * /*w*/, BlockType b,
+    template<typename G>
+    void Ui::RedrawWell(const Well<G> * /*w*/, BlockType b,
                         const BlockPosition & p) {
-        for (int i = 0; i < WellWidth; ++i)
-            for (int j = 0; j < WellHeight; ++j) {
-                Dot d{i, j};
-                _wellWin.DrawDot(d, _colors[j + 2][i]);
+        // the locked blocks and the falling one
+        ColorWell frame = _colors;
+        for (const auto & d : p.GetDots(b))
+            if (d.template IsValid<G>()) frame[d.y + 2][d.x] = GetColor(b);
+
+        // draws only the dots which changed since the last frame, i.e.
+        // usually those of the falling block before and after the move
+        bool changed = false;
+        for (int j = 0; j < G::Height; ++j)
+            for (int i = 0; i < G::Width; ++i) {
+                const Color c = frame[j + 2][i];
+                if (c == _drawn[j + 2][i]) continue;
+                _wellWin->DrawDot(Dot{i, j}, c);
+                _drawn[j + 2][i] = c;
+                changed          = true;
             }
+        if (changed) wrefresh(*_wellWin);
+    }
 
-        for (const auto & d : p.GetDots(b)) _wellWin.DrawDot(d, GetColor(b));
-
-        wrefresh(_wellWin);
+    void Ui::ForgetWell() {
+        for (auto & line : _drawn) line.fill(-1);  // no color is negative
     }
 
     void Ui::ClearNext() {
-        wmove((WINDOW *)_nextWin, 1, 0);
-        wclrtobot((WINDOW *)_nextWin);
-        wrefresh(_nextWin);
+        wmove((WINDOW *)*_nextWin, 1, 0);
+        wclrtobot((WINDOW *)*_nextWin);
+        wrefresh(*_nextWin);
     }
 
     void Ui::RedrawNext(BlockType b) {
-        wmove((WINDOW *)_nextWin, 1, 0);
-        wclrtobot((WINDOW *)_nextWin);
+        wmove((WINDOW *)*_nextWin, 1, 0);
+        wclrtobot((WINDOW *)*_nextWin);
 
         BlockPosition p(Dot{2, 2});
 
-        for (const auto & d : p.GetDots(b)) _nextWin.DrawDot(d, GetColor(b));
-        wrefresh(_nextWin);
+        for (const auto & d : p.GetDots(b)) _nextWin->DrawDot(d, GetColor(b));
+        wrefresh(*_nextWin);
     }
 
     void Ui::RedrawScore() {
-        wattrset((WINDOW *)_scoreWin, COLOR_PAIR(17));
-        mvwprintw(_scoreWin, 1, 7, "%6d", _points);
-        wattrset((WINDOW *)_scoreWin, COLOR_PAIR(18));
-        mvwprintw(_scoreWin, 3, 7, "%6d", _lines);
-        wattrset((WINDOW *)_scoreWin, COLOR_PAIR(19));
-        mvwprintw(_scoreWin, 5, 7, "%6d", _level);
-        wrefresh(_scoreWin);
+        wattrset((WINDOW *)*_scoreWin, COLOR_PAIR(17));
+        mvwprintw(*_scoreWin, 1, 7, "%6d", _points);
+        wattrset((WINDOW *)*_scoreWin, COLOR_PAIR(18));
+        mvwprintw(*_scoreWin, 3, 7, "%6d", _lines);
+        wattrset((WINDOW *)*_scoreWin, COLOR_PAIR(19));
+        mvwprintw(*_scoreWin, 5, 7, "%6d", _level);
+        wrefresh(*_scoreWin);
+    }
+
+    // n in 8 characters at most
+    static string ShortCount(uint64_t n) {
+        if (n < 100000000) return str(format("%8d") % n);
+        return str(format("%7dM") % (n / 1000000));
+    }
+
+    void Ui::RedrawStats() {
+        if (!_statsWin) return;
+        // the counts are since the last redraw, i.e. for the last block
+        const SearchStats total = CollectStats();
+        SearchStats       last  = total;
+        last -= _statsShown;
+        _statsShown = total;
+
+        wattrset((WINDOW *)*_statsWin, COLOR_PAIR(17));
+        mvwprintw(*_statsWin, 1, 6, "%6.1fms", total.lastGetNextNs / 1e6);
+        mvwprintw(*_statsWin, 2, 6, "%6.1fms", total.AverageGetNextNs() / 1e6);
+        mvwprintw(*_statsWin, 3, 6, "%s",
+                  ShortCount(last.Get(Counter::Vertices)).c_str());
+        mvwprintw(*_statsWin, 4, 6, "%s",
+                  ShortCount(last.Get(Counter::Evaluations)).c_str());
+        wrefresh(*_statsWin);
     }
 
     void Ui::CompletedLinesAnimation(const LinesCompleted & completed) {
-        wattrset((WINDOW *)_wellWin, COLOR_PAIR(22));
+        WINDOW * well = *_wellWin;
+        wattrset(well, COLOR_PAIR(22));
         for (int i = 0; i < 6; ++i) {
             for (int k = 0; k < 4; ++k) {
                 if (completed._completed[k]) {
-                    wmove(_wellWin, completed._baseY + k, 0);
-                    whline(_wellWin, i % 2 ? ' ' : ':', WellWidth * 2);
+                    wmove(well, completed._baseY + k, 0);
+                    whline(well, i % 2 ? ' ' : ':', getmaxx(well));
                 }
-                wrefresh(_wellWin);
+                wrefresh(well);
                 usleep(500000 / 6);
             }
         }
+        ForgetWell();
     }
 
-    void Ui::Play(BlockChooser * bc) {
+    template<typename G>
+    void Ui::Play(BlockChooser<G> * bc, Replay * replay) {
         _level  = 0;
         _points = 0;
         _lines  = 0;
 
         for (auto & array : _colors) array.fill(0);
+        Layout(G::Width, G::Height);
         RedrawStatic();
         RedrawScore();
-        Well w;
+        ResetStats();
+        _statsShown = CollectStats();
+        Well<G> w;
         nodelay(stdscr, TRUE);
         Queue q = bc->GetStartingQueue();
+        _replay = replay;
+        if (_replay) {
+            _replay->seed   = bc->GetSeed();
+            _replay->width  = G::Width;
+            _replay->height = G::Height;
+            _replay->startingQueue.clear();
+            _replay->pieces.clear();
+            for (Queue r = q; !r.empty(); r.pop())
+                _replay->startingQueue.push_back(r.front());
+        }
         if (q.size() == 1)  // no block preview
             ClearNext();
         try {
@@ -498,13 +624,30 @@ namespace Bastet {
                 auto current = q.front();
                 q.pop();
                 if (!q.empty()) RedrawNext(q.front());
-                DropBlock(current, &w);
-                q.push(bc->GetNext(&w, q));
+                DropBlock(current, &w, bc, q);
+                const auto start = chrono::steady_clock::now();
+                const auto next  = bc->GetNext(&w, q);
+                config.GetLatencies()->Record(
+                    chrono::steady_clock::now() - start, w.GetMaxHeight(),
+                    next);
+                q.push(next);
+                RedrawStats();
+                if (_replay) {
+                    auto & piece  = _replay->pieces.back();
+                    piece.hasNext = true;
+                    piece.next    = next;
+                    auto * deep   = dynamic_cast<DeepBlockChooser<G> *>(bc);
+                    if (deep) piece.depth = deep->GetLastDepth();
+                }
             }
         } catch (GameOver & go) {}
+        _replay = nullptr;
         return;
     }
 
+    template void Ui::Play(BlockChooser<StandardGeometry> *, Replay *);
+    template void Ui::Play(BlockChooser<WideGeometry> *, Replay *);
+
     void Ui::HandleHighScores(difficulty_t diff) {
         auto * hs = config.GetHighScores(diff);
         if (hs->Qualifies(_points)) {
@@ -528,6 +671,10 @@ namespace Bastet {
             allscores += "**Normal difficulty**\n";
         else if (diff == difficulty_hard)
             allscores += "**Hard difficulty**\n";
+        else if (diff == difficulty_deep)
+            allscores += "**Deep difficulty**\n";
+        else if (diff == difficulty_wide)
+            allscores += "**Wide difficulty**\n";
         format fmt("%-20.20s %8d\n");
         for (auto it = hs->rbegin(); it != hs->rend(); ++it) {
             allscores += str(fmt % it->Scorer % it->Score);
@@ -21,17 +21,25 @@
 
 #include <curses.h>
 
+#include <memory>
 #include <string>
 
 #include "BlockChooser.hpp"
 #include "BlockPosition.hpp"
 #include "Config.hpp"
+#include "Replay.hpp"
+#include "SearchStats.hpp"
 #include "Well.hpp"
 
 namespace Bastet {
     //(points, lines)
     using Score = std::pair<int, int>;
 
+    // to be given to wattrset
+    using Color = int;
+
+    Color GetColor(BlockType b);
+
     Score & operator+=(Score & a, const Score & b);
 
     class BorderedWindow {
@@ -72,16 +80,28 @@ namespace Bastet {
         int  MenuDialog(const std::vector<std::string> &
                             choices);  // asks to choose one, returns index
         void RedrawStatic();  // redraws the "static" parts of the screen
-        void RedrawWell(const Well * well, BlockType falling,
+        template<typename G>
+        void RedrawWell(const Well<G> * well, BlockType falling,
                         const BlockPosition & pos);
         void ClearNext();                 // clear the next block display
         void RedrawNext(BlockType next);  // redraws the next block display
         void RedrawScore();
+        /// the chooser panel, only built with BASTET_STATS: latency of the
+        /// last GetNext and the average one, and the work it took
+        void RedrawStats();
         void CompletedLinesAnimation(const LinesCompleted & completed);
-        void DropBlock(BlockType b, Well * w);  // returns <score,lines>
+        /// bc and q are only used to let bc know where the block is
+        /// likely to land
+        template<typename G>
+        void DropBlock(BlockType b, Well<G> * w, BlockChooser<G> * bc,
+                       const Queue & q);
 
         void ChooseLevel();
-        void Play(BlockChooser * bc);
+        /// if replay is given, records the game into it (all but the
+        /// chooser type, which the caller knows). Instantiated for the
+        /// standard and the wide geometry, which fit into ColorWell
+        template<typename G>
+        void Play(BlockChooser<G> * bc, Replay * replay = nullptr);
         void HandleHighScores(
             difficulty_t diff);  /// if needed, asks name for highscores
         void ShowHighScores(difficulty_t diff);
@@ -89,20 +109,30 @@ namespace Bastet {
 
        private:
         //    difficulty_t _difficulty; //unused for now
-        int            _level;
-        int            _points;
-        int            _lines;
-        Curses         _curses;
-        BorderedWindow _wellWin;
-        BorderedWindow _nextWin;
-        BorderedWindow _scoreWin;
+        int                             _level;
+        int                             _points;
+        int                             _lines;
+        Curses                          _curses;
+        std::unique_ptr<BorderedWindow> _wellWin;
+        std::unique_ptr<BorderedWindow> _nextWin;
+        std::unique_ptr<BorderedWindow> _scoreWin;
+        std::unique_ptr<BorderedWindow> _statsWin;  // only with BASTET_STATS
+        SearchStats                     _statsShown;
+        Replay *                        _replay;  // of the game being played
         /**
          * this is a kind of "well" structure to store the colors used to draw
          * the blocks.
          */
-        using ColorWellLine = std::array<Color, WellWidth>;
-        using ColorWell     = std::array<ColorWellLine, RealWellHeight>;
+        using ColorWellLine = std::array<Color, WideGeometry::Width>;
+        using ColorWell = std::array<ColorWellLine, WideGeometry::RealHeight>;
         ColorWell _colors;
+        /// what RedrawWell last drew, falling block included
+        ColorWell _drawn;
+        /// makes the next RedrawWell draw every dot, for when something else
+        /// has been drawn over the well
+        void ForgetWell();
+        /// builds the windows around a well of the given size
+        void Layout(int width, int height);
     };
 }  // namespace Bastet
 
@@ -18,6 +18,7 @@
 
 #include "Well.hpp"
 
+#include <algorithm>
 #include <boost/foreach.hpp>
 #include <cassert>
 #include <cstring>
@@ -25,68 +26,227 @@
 
 namespace Bastet {
 
-    std::string WellLine::PrettyPrint() const {
-        std::string s;
-        s.reserve(this->size());
-        for (unsigned int i = 0; i < this->size(); ++i)
-            s.push_back(operator[](i) ? '#' : ' ');
-        return s;
-    }
+    namespace {
+        // splitmix64, only used to fill in the Zobrist keys
+        uint64_t NextKey(uint64_t & state) {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z          = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        // one random key per bit of each line of a well of geometry G; the
+        // walls are never hashed
+        template<typename G>
+        struct Zobrist {
+            using Keys
+                = std::array<std::array<uint64_t, G::LineBits>, G::RealHeight>;
+
+            static Keys Make() {
+                Keys     keys;
+                uint64_t state = 37;
+                for (auto & line : keys)
+                    for (auto & key : line) key = NextKey(state);
+                return keys;
+            }
+
+            static const Keys keys;
+        };
+
+        template<typename G>
+        const typename Zobrist<G>::Keys Zobrist<G>::keys = Zobrist<G>::Make();
+
+        // xor of the keys of the dots in l, which lies at index i of the well
+        template<typename G>
+        uint64_t LineHash(int i, typename G::Line l) {
+            uint64_t h = 0;
+            for (unsigned bits = l & G::LineMask; bits != 0; bits &= bits - 1)
+                h ^= Zobrist<G>::keys[i][__builtin_ctz(bits)];
+            return h;
+        }
 
-    Well::Well() { Clear(); }
+        template<typename G>
+        std::string PrettyPrintLine(typename G::Line l) {
+            std::string s;
+            s.reserve(G::Width);
+            for (int x = 0; x < G::Width; ++x)
+                s.push_back((l & G::DotMask(x)) ? '#' : ' ');
+            return s;
+        }
+    }  // namespace
+
+    template<typename G>
+    Well<G>::Well() { Clear(); }
 
-    Well::~Well() {}
+    template<typename G>
+    Well<G>::~Well() {}
 
-    void Well::Clear() {
-        BOOST_FOREACH (WellLine & l, _well) { l.reset(); }
+    template<typename G>
+    void Well<G>::Clear() {
+        _well.fill(G::EmptyLine);
+        _hash = 0;
+        _heights.fill(0);
+        _maxHeight = 0;
     }
 
-    bool Well::Accomodates(const DotMatrix & m) const {
-        BOOST_FOREACH (const Dot & d, m) {
-            if (!d.IsValid() || _well[d.y + 2][d.x] == true) return false;
+    template<typename G>
+    void Well<G>::UpdateHeights() {
+        _heights.fill(0);
+        _maxHeight = 0;
+        // top-down, each column gets the height of the first line with a dot
+        // in it; the walls count as already seen
+        Line seen = G::EmptyLine;
+        for (int i = 0; i < G::RealHeight && seen != G::FullLine; ++i) {
+            Line fresh = _well[i] & ~seen;
+            if (!fresh) continue;
+            if (!_maxHeight) _maxHeight = G::RealHeight - i;
+            seen |= fresh;
+            for (; fresh != 0; fresh &= fresh - 1)
+                _heights[__builtin_ctz(fresh) - WallWidth] = G::RealHeight - i;
         }
-        return true;
     }
 
-    bool Well::IsLineComplete(int y) const {
-        for (int x = 0; x < (int)WellWidth; ++x)
-            if (_well[y + 2][x] == false) return false;
+    template<typename G>
+    uint64_t Well<G>::LinesHash(int from, int to) const {
+        uint64_t h = 0;
+        for (int i = from; i < to; ++i) h ^= LineHash<G>(i, _well[i]);
+        return h;
+    }
+
+    template<typename G>
+    bool Well<G>::Accomodates(BlockType b, const BlockPosition & p) const {
+        const BlockShape & s   = p.GetShape(b);
+        const Dot &        pos = p.GetPos();
+        // the walls take care of the sides, as long as the block is not so far
+        // off that it misses them too
+        if (pos.x < -WallWidth || pos.x >= G::Width || pos.y + s.min.y < -2
+            || pos.y + s.max.y >= G::Height)
+            return false;
+        const int shift = pos.x + WallWidth;
+        for (int k = s.min.y; k <= s.max.y; ++k)
+            if (_well[pos.y + 2 + k] & (s.lines[k] << shift)) return false;
         return true;
     }
 
-    LinesCompleted Well::Lock(BlockType t, const BlockPosition & p) {
-        if (p.IsOutOfScreen(t)) throw(GameOver());
-        BOOST_FOREACH (const Dot & d, p.GetDots(t)) {
-            _well[d.y + 2][d.x] = true;
+    template<typename G>
+    LinesCompleted Well<G>::Lock(BlockType t, const BlockPosition & p) {
+        LinesCompleted lc;
+        if (!TryLock(t, p, lc)) throw(GameOver());
+        return lc;
+    }
+
+    template<typename G>
+    bool Well<G>::TryLock(BlockType t, const BlockPosition & p,
+                          LinesCompleted & lc) {
+        if (p.IsOutOfScreen(t)) return false;
+        const BlockShape & s     = p.GetShape(t);
+        const int          shift = p.GetPos().x + WallWidth;
+        for (int k = s.min.y; k <= s.max.y; ++k) {
+            const int  i    = p.GetBaseY() + 2 + k;
+            const Line dots = Line(s.lines[k] << shift);
+            _hash ^= LineHash<G>(i, dots & ~_well[i]);
+            _well[i] |= dots;
+        }
+        for (int dx = s.min.x; dx <= s.max.x; ++dx) {
+            const int x = p.GetPos().x + dx;
+            const int h = G::RealHeight - (p.GetBaseY() + 2 + s.top[dx]);
+            if (h > _heights[x]) _heights[x] = h;
+            if (h > _maxHeight) _maxHeight = h;
         }
         // checks for completedness
-        LinesCompleted lc;
         lc._baseY = p.GetBaseY();
+        lc._completed.reset();
         for (int k = 0; k < 4; ++k) {
             int l = lc._baseY + k;
             if (IsValidLine(l) && IsLineComplete(l)) lc._completed[k] = true;
         }
-        return lc;
+        return true;
     }
 
-    void Well::ClearLines(const LinesCompleted & completed) {
-        WellType::reverse_iterator it
+    template<typename G>
+    void Well<G>::ClearLines(const LinesCompleted & completed) {
+        if (completed._completed.none()) return;
+        // only the lines down to the bottom of the tetromino can change
+        const int bottom = std::min(completed._baseY + 2 + 4, G::RealHeight);
+        _hash ^= LinesHash(0, bottom);
+        typename WellType::reverse_iterator it
             = completed.Clear(_well.rbegin(), _well.rend());
-        for (; it != _well.rend(); ++it) { it->reset(); }
+        std::fill(it, _well.rend(), G::EmptyLine);
+        _hash ^= LinesHash(0, bottom);
+        UpdateHeights();
     }
 
-    int Well::LockAndClearLines(BlockType t, const BlockPosition & p) {
+    template<typename G>
+    int Well<G>::LockAndClearLines(BlockType t, const BlockPosition & p) {
         LinesCompleted lc = Lock(t, p);
         ClearLines(lc);
         return lc._completed.count();
     }
 
-    std::string Well::PrettyPrint() const {
+    template<typename G>
+    int Well<G>::TryLockAndClearLines(BlockType t, const BlockPosition & p) {
+        LinesCompleted lc;
+        if (!TryLock(t, p, lc)) return LockedOut;
+        ClearLines(lc);
+        return lc._completed.count();
+    }
+
+    template<typename G>
+    int Well<G>::TryLockAndClearLines(BlockType t, const BlockPosition & p,
+                                      WellUndo<G> & undo) {
+        const BlockShape & s     = p.GetShape(t);
+        const int          shift = p.GetPos().x + WallWidth;
+        undo.hash      = _hash;
+        undo.heights   = _heights;
+        undo.maxHeight = _maxHeight;
+        undo.added.fill(0);
+        if (!p.IsOutOfScreen(t)) {
+            for (int k = s.min.y; k <= s.max.y; ++k)
+                undo.added[k]
+                    = (s.lines[k] << shift) & ~_well[p.GetBaseY() + 2 + k];
+        }
+        if (!TryLock(t, p, undo.lines)) return LockedOut;
+        ClearLines(undo.lines);
+        return undo.lines._completed.count();
+    }
+
+    template<typename G>
+    void Well<G>::Undo(const WellUndo<G> & undo) {
+        const LinesCompleted & lc  = undo.lines;
+        const int              top = lc._baseY + 2;
+        if (lc._completed.any()) {
+            const int bottom = std::min(top + 4, G::RealHeight);
+            const int n      = lc._completed.count();
+            // the lines of the tetromino which survived, bottom-up
+            std::array<Line, 4> kept;
+            for (int i = bottom - 1, j = 0; i >= top + n; --i)
+                kept[j++] = _well[i];
+            // the lines above the tetromino were moved down by n
+            std::copy(_well.begin() + n, _well.begin() + n + top,
+                      _well.begin());
+            // puts the cleared lines back among the others
+            for (int i = bottom - 1, j = 0; i >= top; --i)
+                _well[i] = lc._completed[i - top] ? G::FullLine : kept[j++];
+        }
+        for (int k = 0; k < 4; ++k) {
+            if (undo.added[k]) _well[top + k] &= ~undo.added[k];
+        }
+        _hash      = undo.hash;
+        _heights   = undo.heights;
+        _maxHeight = undo.maxHeight;
+    }
+
+    template<typename G>
+    std::string Well<G>::PrettyPrint() const {
         std::ostringstream str;
-        str << std::string(WellWidth + 2, '-') << '\n';
-        BOOST_FOREACH (const WellLine & l, _well)
-            str << '|' << l.PrettyPrint() << "|\n";
-        str << std::string(WellWidth + 2, '-');
+        str << std::string(G::Width + 2, '-') << '\n';
+        BOOST_FOREACH (const Line & l, _well)
+            str << '|' << PrettyPrintLine<G>(l) << "|\n";
+        str << std::string(G::Width + 2, '-');
         return str.str();
     }
+
+#define INSTANTIATE(G) template class Well<G>;
+    BASTET_GEOMETRIES(INSTANTIATE)
+#undef INSTANTIATE
 }  // namespace Bastet
@@ -19,12 +19,15 @@
 #ifndef WELL_HPP
 #define WELL_HPP
 
+#include <algorithm>
 #include <bitset>
 #include <boost/array.hpp>
+#include <cassert>
 #include <cstddef>  //size_t
+#include <cstdint>
 #include <vector>
 
-#include "Block.hpp"  //for Color
+#include "Block.hpp"
 #include "BlockPosition.hpp"
 
 // DBG
@@ -34,11 +37,6 @@ namespace Bastet {
 
     class GameOver {};  // used as an exception
 
-    class WellLine : public std::bitset<WellWidth> {
-       public:
-        std::string PrettyPrint() const;
-    };
-
     /// complex type that holds which lines are completed
     /// if _completed[k]==true, then line _baseY+k exists and is completed
     class LinesCompleted {
@@ -51,23 +49,53 @@ namespace Bastet {
         Iterator Clear(Iterator rbegin, Iterator rend) const;
     };
 
+    /// what a reversible lock changed in a well of geometry G, see
+    /// Well::Undo
+    template<typename G>
+    struct WellUndo {
+        LinesCompleted                  lines;      // which lines were cleared
+        std::array<typename G::Line, 4> added;      // dots set in line _baseY+k
+        uint64_t                        hash;       // the hash before the lock
+        std::array<uint8_t, G::Width>   heights;    // and the column heights
+        uint8_t                         maxHeight;  // and their max
+    };
+
     /*
-     * the real height of the well is _height+2, with the top two rows( -1 and
-     * -2) hidden (see guidelines)
+     * a well of geometry G (see BasicGeometry): the real height of the well is
+     * G::Height+2, with the top two rows( -1 and -2) hidden (see guidelines)
      */
+    template<typename G>
     class Well {
+       public:
+        using Geometry = G;
+        using Line     = typename G::Line;
+
        private:
-        typedef boost::array<WellLine, RealWellHeight> WellType;
-        WellType                                       _well;
+        typedef boost::array<Line, G::RealHeight> WellType;
+        WellType                                  _well;
+        uint64_t _hash;  // Zobrist hash of the occupied dots
+        // number of lines from the bottom of _well up to the highest dot of
+        // each column (0 for an empty column), and their max
+        std::array<uint8_t, G::Width> _heights;
+        uint8_t                       _maxHeight;
+
+        // xor of the Zobrist keys of the dots in lines [from,to) of _well
+        uint64_t LinesHash(int from, int to) const;
+        // recomputes _heights and _maxHeight from _well
+        void UpdateHeights();
 
        public:
         Well();
         ~Well();
         void Clear();
-        bool Accomodates(const DotMatrix & d)
+        bool Accomodates(BlockType b, const BlockPosition & p)
             const;  // true if the given tetromino fits into the well
-        bool IsValidLine(int y) const { return (y >= -2) && (y < WellHeight); };
-        bool IsLineComplete(int y) const;
+        bool IsValidLine(int y) const { return (y >= -2) && (y < G::Height); };
+        bool IsLineComplete(int y) const {
+            return _well[y + 2] == G::FullLine;
+        }
+        /// the packed line y, for y in [-2, G::Height)
+        Line GetLine(int y) const { return _well[y + 2]; }
         LinesCompleted Lock(
             BlockType t,
             const BlockPosition &
@@ -81,28 +109,53 @@ namespace Bastet {
             BlockType t,
             const BlockPosition &
                 p);  // locks, clear lines, returns number of lines cleared
-        friend long Evaluate(const Well * w,
-                             int extralines);  // for BastetBlockChooser
+
+        // non-throwing versions of the above, for the block choosers: when
+        // the tetromino would lock out of screen (i.e., game over) they leave
+        // the well untouched and return false or LockedOut
+        static constexpr int LockedOut = -1;
+        bool TryLock(BlockType t, const BlockPosition & p, LinesCompleted & lc);
+        int  TryLockAndClearLines(BlockType t, const BlockPosition & p);
+        // reversible version of the above, which also fills in undo (unless
+        // it returns LockedOut) so that Undo(undo) restores the well as it was
+        // before. Several locks can be undone, in reverse order.
+        int  TryLockAndClearLines(BlockType t, const BlockPosition & p,
+                                  WellUndo<G> & undo);
+        void Undo(const WellUndo<G> & undo);
         std::string PrettyPrint() const;
+        /// hash of the well contents, kept up to date by Lock and ClearLines
+        uint64_t GetHash() const { return _hash; }
+        /// lines from the bottom of the well (including the two hidden ones)
+        /// up to the highest dot of column x, 0 if the column is empty. Kept
+        /// up to date by Lock and ClearLines
+        int GetColumnHeight(int x) const { return _heights[x]; }
+        /// max of the column heights
+        int GetMaxHeight() const { return _maxHeight; }
+        bool     operator==(const Well & w) const {
+            return _hash == w._hash && _well == w._well;
+        }
     };
 
     template<typename Iterator>
     Iterator LinesCompleted::Clear(Iterator rbegin, Iterator rend) const {
         if (_completed.none()) return rend;
-        Iterator orig = rbegin;
-        Iterator dest = rbegin;
-        int      j    = WellHeight - 1;
-        while (orig < rend) {
-            if (j - _baseY >= 0 && j - _baseY < 4 && _completed[j - _baseY]) {
-                // skip
-            } else {
+        // [rbegin, rend) are all the lines of the well, the two hidden ones
+        // included, and the lines below the tetromino are left untouched
+        const int height = int(rend - rbegin) - 2;
+        // the loop below reads up to line _baseY, which must be in the well
+        assert(_baseY >= -2 && _baseY < height);
+        int       j      = std::min(_baseY + 3, height - 1);
+        Iterator  orig   = rbegin + (height - 1 - j);
+        Iterator  dest   = orig;
+        // compacts the (at most 4) lines spanned by the tetromino
+        for (; j >= _baseY; --j, ++orig) {
+            if (!_completed[j - _baseY]) {
                 *dest = *orig;
                 dest++;
             }
-            j--;
-            orig++;
         }
-        return dest++;
+        // and moves everything above them down in one go
+        return std::copy(orig, rend, dest);
     }
 
 }  // namespace Bastet
@@ -17,9 +17,12 @@
  */
 
 #include <boost/assign.hpp>
+#include <chrono>
+#include <thread>
 
 #include "BastetBlockChooser.hpp"
 #include "Config.hpp"
+#include "OpeningBook.hpp"
 #include "Ui.hpp"
 
 // DBG
@@ -31,35 +34,115 @@ using namespace std;
 using namespace boost;
 using namespace boost::assign;
 
-int main() {
+int main(int argc, char ** argv) {
+    if (argc == 2 && string(argv[1]) == "--latency-report") {
+        LatencyHistogram latencies;
+        if (!latencies.Load(config.GetLatencyFileName())) {
+            cerr << "bastet: no latencies in " << config.GetLatencyFileName()
+                 << "\n";
+            return 1;
+        }
+        latencies.PrintReport(cout);
+        return 0;
+    }
+    if ((argc == 2 || argc == 3) && string(argv[1]) == "--replay") {
+        const string fileName
+            = argc == 3 ? argv[2] : config.GetReplayFileName();
+        Replay replay;
+        if (!replay.Load(fileName)) {
+            cerr << "bastet: " << fileName << " is not a replay\n";
+            return 1;
+        }
+        const auto  start = chrono::steady_clock::now();
+        ReplayCheck check
+            = CheckReplay(replay, std::thread::hardware_concurrency());
+        const double s = chrono::duration<double>(chrono::steady_clock::now()
+                                                  - start)
+                             .count();
+        cout << format("%d of %d blocks played again in %.3fs (%.0f/s)\n")
+                    % check.pieces % replay.pieces.size() % s
+                    % (check.pieces / s);
+        if (!check.matches) {
+            cout << "the game differs at " << check.error << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 1) {
+        cerr << "usage: " << argv[0]
+             << " [--latency-report | --replay [file]]\n";
+        return 2;
+    }
+
+    // optional: without it the choosers search every well
+    OpeningBook book;
+    book.Open(config.GetOpeningBookFileName());
+
     Ui ui;
     while (1) {
         int choice = ui.MenuDialog(
             list_of("Play! (normal version)")("Play! (harder version)")(
+                "Play! (deeper version)")("Play! (wider version)")(
                 "View highscores")("Customize keys")("Quit"));
         switch (choice) {
             case 0: {
                 // ui.ChooseLevel();
-                BastetBlockChooser bc;
-                ui.Play(&bc);
+                BastetBlockChooser<StandardGeometry> bc(
+                    std::thread::hardware_concurrency());
+                bc.SetOpeningBook(&book);
+                Replay replay;
+                replay.chooser = ChooserType::Bastet;
+                ui.Play(&bc, &replay);
+                replay.Save(config.GetReplayFileName());
                 ui.HandleHighScores(difficulty_normal);
                 ui.ShowHighScores(difficulty_normal);
             } break;
             case 1: {
                 // ui.ChooseLevel();
-                NoPreviewBlockChooser bc;
-                ui.Play(&bc);
+                NoPreviewBlockChooser<StandardGeometry> bc;
+                Replay                                  replay;
+                replay.chooser = ChooserType::NoPreview;
+                ui.Play(&bc, &replay);
+                replay.Save(config.GetReplayFileName());
                 ui.HandleHighScores(difficulty_hard);
                 ui.ShowHighScores(difficulty_hard);
             } break;
-            case 2:
+            case 2: {
+                // ui.ChooseLevel();
+                DeepBlockChooser<StandardGeometry> bc(
+                    std::chrono::milliseconds(config.GetSearchBudget()),
+                    DeepBlockChooser<StandardGeometry>::DefaultMaxDepth,
+                    std::thread::hardware_concurrency());
+                bc.SetOpeningBook(&book);
+                Replay replay;
+                replay.chooser = ChooserType::Deep;
+                ui.Play(&bc, &replay);
+                replay.Save(config.GetReplayFileName());
+                ui.HandleHighScores(difficulty_deep);
+                ui.ShowHighScores(difficulty_deep);
+            } break;
+            case 3: {
+                // ui.ChooseLevel();
+                BastetBlockChooser<WideGeometry> bc(
+                    std::thread::hardware_concurrency());
+                bc.SetOpeningBook(&book);  // ignored unless built for it
+                Replay replay;
+                replay.chooser = ChooserType::Bastet;
+                ui.Play(&bc, &replay);
+                replay.Save(config.GetReplayFileName());
+                ui.HandleHighScores(difficulty_wide);
+                ui.ShowHighScores(difficulty_wide);
+            } break;
+            case 4:
                 ui.ShowHighScores(difficulty_normal);
                 ui.ShowHighScores(difficulty_hard);
+                ui.ShowHighScores(difficulty_deep);
+                ui.ShowHighScores(difficulty_wide);
                 break;
-            case 3:
+            case 5:
                 ui.CustomizeKeys();
                 break;
-            case 4:
+            case 6:
                 exit(0);
                 break;
         }